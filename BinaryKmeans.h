@@ -0,0 +1,309 @@
+//
+// Created by root on 10/16/26.
+//
+
+#ifndef ENTITYRESOLUTION_BINARYKMEANS_H
+#define ENTITYRESOLUTION_BINARYKMEANS_H
+
+#include <stdint.h>
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+#include "BitMatrix.h"
+#include "Parallel.h"
+
+/**
+ * k-modes clustering of packed binary filters. Points are assigned to the centroid at the smallest Hamming
+ * distance (popcount of XOR) and each centroid bit is the majority vote of its members, so filters are never
+ * unpacked and the working set stays at one bit per filter bit.
+ *
+ * Hamming distance is a metric, so Hamerly's bounds can skip most distance computations once centroids
+ * settle: each point keeps an upper bound to its own centroid and a lower bound to every other one.
+ */
+class BinaryKmeans {
+public:
+    BinaryKmeans(uint16_t k, unsigned threads = 0, bool prune = true)
+            : k(k),
+              threads(threads == 0 ? hardwareThreads() : threads),
+              prune(prune),
+              lastDistanceCount(0),
+              lastIterationCount(0) {}
+
+    inline const BitMatrix &getMeans() const {
+        return means;
+    }
+
+    /**
+     * Cluster from scratch, seeding centroids k-means++ style with probability proportional to squared
+     * Hamming distance (the binary counterpart of arma::random_spread)
+     * @param data Packed filters, one per row
+     * @param noOfIterations Maximum number of iterations
+     * @param seed Seed for centroid selection
+     * @return false if there are fewer filters than clusters
+     */
+    bool fit(const BitMatrixView &data, uint16_t noOfIterations, uint64_t seed = 0) {
+        if (data.nRows() < k || k == 0) {
+            std::cout << "clustering failed" << std::endl;
+            return false;
+        }
+        seedMeans(data, seed);
+        iterate(data, noOfIterations);
+        return true;
+    }
+
+    /**
+     * Continue clustering from existing centroids (the binary counterpart of arma::keep_existing)
+     * @param data Packed filters, one per row
+     * @param initialMeans k centroids of the same length as the filters
+     * @param noOfIterations Maximum number of iterations
+     */
+    bool fit(const BitMatrixView &data, const BitMatrixView &initialMeans, uint16_t noOfIterations) {
+        if (initialMeans.nRows() != k || initialMeans.nBits() != data.nBits() || data.nRows() == 0) {
+            std::cout << "clustering failed" << std::endl;
+            return false;
+        }
+        means = BitMatrix(k, data.nBits());
+        for (uint16_t c = 0; c < k; c++) {
+            std::copy(initialMeans.row(c), initialMeans.row(c) + data.nWords(), means.row(c));
+        }
+        iterate(data, noOfIterations);
+        return true;
+    }
+
+    /**
+     * Assign each filter to its nearest centroid (lowest index on ties)
+     * @param data Packed filters, one per row
+     * @return Cluster of every filter
+     */
+    std::vector<uint16_t> apply(const BitMatrixView &data) const {
+        std::vector<uint16_t> predictions(data.nRows());
+        parallelFor(0, data.nRows(), 4096, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; i++) {
+                predictions[i] = nearest(data.row(i), data.nWords()).first;
+            }
+        }, threads);
+        return predictions;
+    }
+
+    /**
+     * Hamming distance computations made by the last fit, to gauge how much the bounds pruned
+     */
+    inline uint64_t distanceCount() const {
+        return lastDistanceCount;
+    }
+
+    /**
+     * Assignment passes made by the last fit, at most noOfIterations
+     */
+    inline uint16_t iterationCount() const {
+        return lastIterationCount;
+    }
+
+private:
+    /**
+     * Nearest centroid and its distance, lowest index on ties
+     */
+    std::pair<uint16_t, uint32_t> nearest(const uint64_t *point, std::size_t words) const {
+        uint16_t best = 0;
+        uint32_t bestDist = std::numeric_limits<uint32_t>::max();
+        for (uint16_t c = 0; c < k; c++) {
+            uint32_t dist = popcountXor(point, means.row(c), words);
+            if (dist < bestDist) {
+                bestDist = dist;
+                best = c;
+            }
+        }
+        return {best, bestDist};
+    }
+
+    void seedMeans(const BitMatrixView &data, uint64_t seed) {
+        std::size_t n = data.nRows();
+        std::size_t words = data.nWords();
+        means = BitMatrix(k, data.nBits());
+        std::mt19937_64 rng(seed);
+
+        std::vector<double> weight(n, std::numeric_limits<double>::max());
+        std::size_t chosen = rng() % n;
+        for (uint16_t c = 0; c < k; c++) {
+            std::copy(data.row(chosen), data.row(chosen) + words, means.row(c));
+            if (c + 1 == k) {
+                break;
+            }
+            //Squared distance to the closest centroid so far
+            double total = 0;
+            for (std::size_t i = 0; i < n; i++) {
+                double dist = popcountXor(data.row(i), means.row(c), words);
+                weight[i] = std::min(weight[i], dist * dist);
+                total += weight[i];
+            }
+            if (total == 0) {
+                //Fewer distinct filters than clusters, fall back to uniform picks
+                chosen = rng() % n;
+                continue;
+            }
+            double target = std::uniform_real_distribution<double>(0, total)(rng);
+            chosen = n - 1;
+            for (std::size_t i = 0; i < n; i++) {
+                target -= weight[i];
+                if (target < 0) {
+                    chosen = i;
+                    break;
+                }
+            }
+        }
+    }
+
+    void iterate(const BitMatrixView &data, uint16_t noOfIterations) {
+        std::size_t n = data.nRows();
+        std::size_t words = data.nWords();
+        std::size_t bits = data.nBits();
+
+        std::vector<uint16_t> assignment(n, 0);
+        std::vector<int32_t> upper(n, 0);
+        std::vector<int32_t> lower(n, 0);
+        std::vector<int32_t> separation(k, 0);
+        std::vector<int32_t> moved(k, 0);
+
+        //Fixed split of the points per thread so vote counts can be kept thread local
+        unsigned blocks = (unsigned) std::min<std::size_t>(threads, n);
+        std::vector<std::vector<uint32_t>> votes(blocks, std::vector<uint32_t>((std::size_t) k * bits));
+        std::vector<std::vector<uint32_t>> sizes(blocks, std::vector<uint32_t>(k));
+        std::vector<uint64_t> distances(blocks, 0);
+        std::vector<uint64_t> changes(blocks, 0);
+
+        lastDistanceCount = 0;
+        lastIterationCount = 0;
+        for (uint16_t iteration = 0; iteration < noOfIterations; iteration++) {
+            lastIterationCount++;
+            bool bounded = prune && iteration > 0;
+            if (bounded) {
+                //Distance from each centroid to its closest other centroid
+                for (uint16_t c = 0; c < k; c++) {
+                    int32_t closest = std::numeric_limits<int32_t>::max();
+                    for (uint16_t o = 0; o < k; o++) {
+                        if (o != c) {
+                            closest = std::min<int32_t>(closest, popcountXor(means.row(c), means.row(o), words));
+                        }
+                    }
+                    separation[c] = closest;
+                }
+            }
+
+            //Assignment step with Hamerly pruning, and majority vote counts for the update step
+            parallelFor(0, blocks, 1, [&](std::size_t block, std::size_t) {
+                std::size_t begin = n * block / blocks;
+                std::size_t end = n * (block + 1) / blocks;
+                std::vector<uint32_t> &blockVotes = votes[block];
+                std::vector<uint32_t> &blockSizes = sizes[block];
+                std::fill(blockVotes.begin(), blockVotes.end(), 0);
+                std::fill(blockSizes.begin(), blockSizes.end(), 0);
+                uint64_t computed = 0;
+                uint64_t changed = 0;
+
+                for (std::size_t i = begin; i < end; i++) {
+                    const uint64_t *point = data.row(i);
+                    uint16_t current = assignment[i];
+                    bool reassign = true;
+                    if (bounded) {
+                        //Strict bounds, so a tie with a lower index centroid is never skipped
+                        if (2 * (int64_t) upper[i] < separation[current] || upper[i] < lower[i]) {
+                            reassign = false;
+                        } else {
+                            upper[i] = popcountXor(point, means.row(current), words);
+                            computed++;
+                            reassign = !(2 * (int64_t) upper[i] < separation[current] || upper[i] < lower[i]);
+                        }
+                    }
+
+                    if (reassign) {
+                        uint32_t best = std::numeric_limits<uint32_t>::max();
+                        uint32_t second = std::numeric_limits<uint32_t>::max();
+                        uint16_t bestIndex = 0;
+                        for (uint16_t c = 0; c < k; c++) {
+                            uint32_t dist = popcountXor(point, means.row(c), words);
+                            if (dist < best) {
+                                second = best;
+                                best = dist;
+                                bestIndex = c;
+                            } else if (dist < second) {
+                                second = dist;
+                            }
+                        }
+                        computed += k;
+                        if (bestIndex != current || iteration == 0) {
+                            changed++;
+                        }
+                        assignment[i] = bestIndex;
+                        upper[i] = best;
+                        lower[i] = k > 1 ? second : std::numeric_limits<int32_t>::max();
+                    }
+
+                    //Count member bits towards the majority vote of the assigned centroid
+                    uint32_t *clusterVotes = blockVotes.data() + (std::size_t) assignment[i] * bits;
+                    blockSizes[assignment[i]]++;
+                    for (std::size_t w = 0; w < words; w++) {
+                        for (uint64_t word = point[w]; word != 0; word &= word - 1) {
+                            clusterVotes[w * 64 + __builtin_ctzll(word)]++;
+                        }
+                    }
+                }
+                distances[block] = computed;
+                changes[block] = changed;
+            }, threads);
+
+            uint64_t changed = 0;
+            for (unsigned block = 0; block < blocks; block++) {
+                lastDistanceCount += distances[block];
+                changed += changes[block];
+            }
+            if (changed == 0 && iteration > 0) {
+                break;
+            }
+
+            //Update step, each centroid bit is set when more than half of the members have it
+            int32_t maxMoved = 0;
+            BitMatrix previous = means;
+            for (uint16_t c = 0; c < k; c++) {
+                uint32_t size = 0;
+                for (unsigned block = 0; block < blocks; block++) {
+                    size += sizes[block][c];
+                }
+                if (size == 0) {
+                    //Empty cluster keeps its centroid
+                    moved[c] = 0;
+                    continue;
+                }
+                uint64_t *centroid = means.row(c);
+                std::fill(centroid, centroid + words, 0);
+                for (std::size_t bit = 0; bit < bits; bit++) {
+                    uint32_t count = 0;
+                    for (unsigned block = 0; block < blocks; block++) {
+                        count += votes[block][(std::size_t) c * bits + bit];
+                    }
+                    if (2 * count > size) {
+                        centroid[bit >> 6] |= uint64_t(1) << (bit & 63);
+                    }
+                }
+                moved[c] = popcountXor(centroid, previous.row(c), words);
+                maxMoved = std::max(maxMoved, moved[c]);
+            }
+
+            //Keep the bounds valid for the moved centroids
+            for (std::size_t i = 0; i < n; i++) {
+                upper[i] += moved[assignment[i]];
+                lower[i] = lower[i] == std::numeric_limits<int32_t>::max() ? lower[i] : lower[i] - maxMoved;
+            }
+        }
+    }
+
+    uint16_t k;
+    unsigned threads;
+    bool prune;
+    uint64_t lastDistanceCount;
+    uint16_t lastIterationCount;
+    BitMatrix means;
+};
+
+#endif //ENTITYRESOLUTION_BINARYKMEANS_H
@@ -0,0 +1,238 @@
+//
+// Created by root on 10/16/26.
+//
+
+#ifndef ENTITYRESOLUTION_BITKERNELS_H
+#define ENTITYRESOLUTION_BITKERNELS_H
+
+#include <stdint.h>
+#include <cstddef>
+
+#if defined(__AVX512F__) && defined(__AVX512VPOPCNTDQ__)
+#define ER_POPCOUNT_AVX512 1
+#include <immintrin.h>
+#elif defined(__AVX2__)
+#define ER_POPCOUNT_AVX2 1
+#include <immintrin.h>
+#endif
+
+/*
+ * Popcount kernels over packed 64-bit words. The widest available path is picked at compile time
+ * (AVX-512 VPOPCNTDQ, then AVX2 nibble lookup), with a scalar fallback for the tail and for other targets.
+ */
+
+inline uint64_t popcountWordsScalar(const uint64_t *a, std::size_t words) {
+    uint64_t count = 0;
+    for (std::size_t i = 0; i < words; i++) {
+        count += __builtin_popcountll(a[i]);
+    }
+    return count;
+}
+
+inline uint64_t popcountAndScalar(const uint64_t *a, const uint64_t *b, std::size_t words) {
+    uint64_t count = 0;
+    for (std::size_t i = 0; i < words; i++) {
+        count += __builtin_popcountll(a[i] & b[i]);
+    }
+    return count;
+}
+
+inline uint64_t popcountXorScalar(const uint64_t *a, const uint64_t *b, std::size_t words) {
+    uint64_t count = 0;
+    for (std::size_t i = 0; i < words; i++) {
+        count += __builtin_popcountll(a[i] ^ b[i]);
+    }
+    return count;
+}
+
+#if defined(ER_POPCOUNT_AVX512)
+inline uint64_t horizontalSum512(__m512i v) {
+    alignas(64) uint64_t lanes[8];
+    _mm512_store_si512(lanes, v);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + lanes[4] + lanes[5] + lanes[6] + lanes[7];
+}
+#endif
+
+#if defined(ER_POPCOUNT_AVX2)
+//Per-byte popcount using the 4-bit lookup table trick (Mula), summed into 64-bit lanes with SAD
+inline __m256i popcount256(__m256i v) {
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i lowMask = _mm256_set1_epi8(0x0f);
+    __m256i lo = _mm256_and_si256(v, lowMask);
+    __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), lowMask);
+    __m256i bytes = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo), _mm256_shuffle_epi8(lookup, hi));
+    return _mm256_sad_epu8(bytes, _mm256_setzero_si256());
+}
+
+inline uint64_t horizontalSum256(__m256i v) {
+    return (uint64_t) _mm256_extract_epi64(v, 0) + (uint64_t) _mm256_extract_epi64(v, 1) +
+           (uint64_t) _mm256_extract_epi64(v, 2) + (uint64_t) _mm256_extract_epi64(v, 3);
+}
+#endif
+
+/**
+ * Count the set bits of a packed bit vector
+ * @param a Packed words
+ * @param words Number of 64-bit words
+ * @return Number of set bits
+ */
+inline uint64_t popcountWords(const uint64_t *a, std::size_t words) {
+#if defined(ER_POPCOUNT_AVX512)
+    __m512i acc = _mm512_setzero_si512();
+    std::size_t i = 0;
+    for (; i + 8 <= words; i += 8) {
+        acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(_mm512_loadu_si512(a + i)));
+    }
+    if (i < words) {
+        __mmask8 tail = (__mmask8) ((1u << (words - i)) - 1);
+        acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(_mm512_maskz_loadu_epi64(tail, a + i)));
+    }
+    return horizontalSum512(acc);
+#elif defined(ER_POPCOUNT_AVX2)
+    __m256i acc = _mm256_setzero_si256();
+    std::size_t i = 0;
+    for (; i + 4 <= words; i += 4) {
+        acc = _mm256_add_epi64(acc, popcount256(_mm256_loadu_si256((const __m256i *) (a + i))));
+    }
+    return horizontalSum256(acc) + popcountWordsScalar(a + i, words - i);
+#else
+    return popcountWordsScalar(a, words);
+#endif
+}
+
+/**
+ * Count the bits set in both of two packed bit vectors, i.e. |A ∩ B|
+ * @param a Packed words of the first vector
+ * @param b Packed words of the second vector
+ * @param words Number of 64-bit words in each vector
+ * @return Size of the intersection
+ */
+inline uint64_t popcountAnd(const uint64_t *a, const uint64_t *b, std::size_t words) {
+#if defined(ER_POPCOUNT_AVX512)
+    __m512i acc = _mm512_setzero_si512();
+    std::size_t i = 0;
+    for (; i + 8 <= words; i += 8) {
+        __m512i v = _mm512_and_si512(_mm512_loadu_si512(a + i), _mm512_loadu_si512(b + i));
+        acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(v));
+    }
+    if (i < words) {
+        __mmask8 tail = (__mmask8) ((1u << (words - i)) - 1);
+        __m512i v = _mm512_and_si512(_mm512_maskz_loadu_epi64(tail, a + i), _mm512_maskz_loadu_epi64(tail, b + i));
+        acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(v));
+    }
+    return horizontalSum512(acc);
+#elif defined(ER_POPCOUNT_AVX2)
+    __m256i acc = _mm256_setzero_si256();
+    std::size_t i = 0;
+    for (; i + 4 <= words; i += 4) {
+        __m256i v = _mm256_and_si256(_mm256_loadu_si256((const __m256i *) (a + i)),
+                                     _mm256_loadu_si256((const __m256i *) (b + i)));
+        acc = _mm256_add_epi64(acc, popcount256(v));
+    }
+    return horizontalSum256(acc) + popcountAndScalar(a + i, b + i, words - i);
+#else
+    return popcountAndScalar(a, b, words);
+#endif
+}
+
+/**
+ * Hamming distance between two packed bit vectors, i.e. |A xor B|
+ * @param a Packed words of the first vector
+ * @param b Packed words of the second vector
+ * @param words Number of 64-bit words in each vector
+ * @return Number of differing bits
+ */
+inline uint64_t popcountXor(const uint64_t *a, const uint64_t *b, std::size_t words) {
+#if defined(ER_POPCOUNT_AVX512)
+    __m512i acc = _mm512_setzero_si512();
+    std::size_t i = 0;
+    for (; i + 8 <= words; i += 8) {
+        __m512i v = _mm512_xor_si512(_mm512_loadu_si512(a + i), _mm512_loadu_si512(b + i));
+        acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(v));
+    }
+    if (i < words) {
+        __mmask8 tail = (__mmask8) ((1u << (words - i)) - 1);
+        __m512i v = _mm512_xor_si512(_mm512_maskz_loadu_epi64(tail, a + i), _mm512_maskz_loadu_epi64(tail, b + i));
+        acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(v));
+    }
+    return horizontalSum512(acc);
+#elif defined(ER_POPCOUNT_AVX2)
+    __m256i acc = _mm256_setzero_si256();
+    std::size_t i = 0;
+    for (; i + 4 <= words; i += 4) {
+        __m256i v = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *) (a + i)),
+                                     _mm256_loadu_si256((const __m256i *) (b + i)));
+        acc = _mm256_add_epi64(acc, popcount256(v));
+    }
+    return horizontalSum256(acc) + popcountXorScalar(a + i, b + i, words - i);
+#else
+    return popcountXorScalar(a, b, words);
+#endif
+}
+
+/**
+ * Pack the comparison values[i] > threshold into bits, bit i in word i / 64 at position i % 64. Bits past
+ * count in the last word are cleared.
+ * @param values Values to compare
+ * @param count Number of values
+ * @param threshold Values strictly above it give a set bit
+ * @param mask (count + 63) / 64 output words
+ */
+inline void thresholdMask(const float *values, std::size_t count, float threshold, uint64_t *mask) {
+    std::size_t i = 0;
+#if defined(__AVX512F__)
+    __m512 limit = _mm512_set1_ps(threshold);
+    for (; i + 64 <= count; i += 64) {
+        uint64_t word = 0;
+        for (int part = 0; part < 4; part++) {
+            __mmask16 above = _mm512_cmp_ps_mask(_mm512_loadu_ps(values + i + 16 * part), limit, _CMP_GT_OQ);
+            word |= (uint64_t) above << (16 * part);
+        }
+        mask[i >> 6] = word;
+    }
+#elif defined(__AVX2__)
+    __m256 limit = _mm256_set1_ps(threshold);
+    for (; i + 64 <= count; i += 64) {
+        uint64_t word = 0;
+        for (int part = 0; part < 8; part++) {
+            __m256 above = _mm256_cmp_ps(_mm256_loadu_ps(values + i + 8 * part), limit, _CMP_GT_OQ);
+            word |= (uint64_t) _mm256_movemask_ps(above) << (8 * part);
+        }
+        mask[i >> 6] = word;
+    }
+#endif
+    for (; i < count; i += 64) {
+        uint64_t word = 0;
+        for (std::size_t bit = 0; bit < 64 && i + bit < count; bit++) {
+            word |= (uint64_t) (values[i + bit] > threshold) << bit;
+        }
+        mask[i >> 6] = word;
+    }
+}
+
+/**
+ * Dice coefficient 2|A ∩ B| / (|A| + |B|) given the intersection and the set bit counts of both filters
+ */
+inline float diceCoefficient(uint64_t intersection, uint64_t countA, uint64_t countB) {
+    uint64_t denominator = countA + countB;
+    return denominator == 0 ? 0.0f : (2.0f * intersection) / denominator;
+}
+
+/**
+ * Jaccard coefficient |A ∩ B| / |A ∪ B| given the intersection and the set bit counts of both filters
+ */
+inline float jaccardCoefficient(uint64_t intersection, uint64_t countA, uint64_t countB) {
+    uint64_t denominator = countA + countB - intersection;
+    return denominator == 0 ? 0.0f : (float) intersection / denominator;
+}
+
+inline float diceCoefficient(const uint64_t *a, const uint64_t *b, std::size_t words) {
+    return diceCoefficient(popcountAnd(a, b, words), popcountWords(a, words), popcountWords(b, words));
+}
+
+inline float jaccardCoefficient(const uint64_t *a, const uint64_t *b, std::size_t words) {
+    return jaccardCoefficient(popcountAnd(a, b, words), popcountWords(a, words), popcountWords(b, words));
+}
+
+#endif //ENTITYRESOLUTION_BITKERNELS_H
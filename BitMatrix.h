@@ -0,0 +1,195 @@
+//
+// Created by root on 10/16/26.
+//
+
+#ifndef ENTITYRESOLUTION_BITMATRIX_H
+#define ENTITYRESOLUTION_BITMATRIX_H
+
+#include <stdint.h>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+#include "BitKernels.h"
+
+/**
+ * Minimal allocator handing out storage aligned to a cache line (or any power of two)
+ */
+template <typename T, std::size_t Alignment = 64>
+struct AlignedAllocator {
+    typedef T value_type;
+
+    template <typename U>
+    struct rebind {
+        typedef AlignedAllocator<U, Alignment> other;
+    };
+
+    AlignedAllocator() = default;
+
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment> &) {}
+
+    T *allocate(std::size_t n) {
+        std::size_t bytes = (n * sizeof(T) + Alignment - 1) / Alignment * Alignment;
+        void *ptr = std::aligned_alloc(Alignment, bytes);
+        if (ptr == nullptr) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T *>(ptr);
+    }
+
+    void deallocate(T *ptr, std::size_t) {
+        std::free(ptr);
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, Alignment> &) const { return true; }
+
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment> &) const { return false; }
+};
+
+/**
+ * Read-only view over rows of packed filters laid out back to back, e.g. a BitMatrix or a memory mapped
+ * filter file. Does not own the words.
+ */
+class BitMatrixView {
+public:
+    BitMatrixView() : data(nullptr), rows(0), bits(0), words(0) {}
+
+    BitMatrixView(const uint64_t *data, std::size_t rows, std::size_t bits)
+            : data(data),
+              rows(rows),
+              bits(bits),
+              words((bits + 63) / 64) {}
+
+    inline const uint64_t *row(std::size_t i) const {
+        return data + i * words;
+    }
+
+    inline bool test(std::size_t i, std::size_t bit) const {
+        return (row(i)[bit >> 6] >> (bit & 63)) & 1;
+    }
+
+    /**
+     * View over rows [begin, end)
+     */
+    inline BitMatrixView rowRange(std::size_t begin, std::size_t end) const {
+        return BitMatrixView(row(begin), end - begin, bits);
+    }
+
+    /**
+     * Set bit counts of every row, used as the |A| and |B| terms of the similarity coefficients
+     */
+    std::vector<uint32_t> rowCounts() const {
+        std::vector<uint32_t> counts(rows);
+        for (std::size_t i = 0; i < rows; i++) {
+            counts[i] = popcountWords(row(i), words);
+        }
+        return counts;
+    }
+
+    inline std::size_t nRows() const { return rows; }
+
+    inline std::size_t nBits() const { return bits; }
+
+    inline std::size_t nWords() const { return words; }
+
+private:
+    const uint64_t *data;
+    std::size_t rows;
+    std::size_t bits;
+    std::size_t words;
+};
+
+/**
+ * Contiguous store of bit-packed filters. Each row is one filter of nBits() bits held in nWords() 64-bit words,
+ * bit b of a filter lives in word b / 64 at position b % 64. Rows are laid out back to back in a single
+ * cache-line aligned buffer so the popcount kernels can stream over them.
+ */
+class BitMatrix {
+public:
+    BitMatrix() : rows(0), bits(0), words(0) {}
+
+    BitMatrix(std::size_t rows, std::size_t bits)
+            : rows(rows),
+              bits(bits),
+              words((bits + 63) / 64),
+              data(rows * ((bits + 63) / 64), 0) {}
+
+    /**
+     * Pack a dense matrix holding one filter per column (non zero entries are set bits)
+     * @param mat Matrix with filterLen rows and one column per filter, e.g. arma::Mat<short>
+     */
+    template <typename M>
+    static BitMatrix fromColumns(const M &mat) {
+        BitMatrix packed(mat.n_cols, mat.n_rows);
+        for (std::size_t c = 0; c < mat.n_cols; c++) {
+            for (std::size_t r = 0; r < mat.n_rows; r++) {
+                if (mat.at(r, c) != 0) {
+                    packed.set(c, r);
+                }
+            }
+        }
+        return packed;
+    }
+
+    /**
+     * Pack a dense matrix holding one filter per row (non zero entries are set bits)
+     * @param mat Matrix with one row per filter and filterLen columns
+     */
+    template <typename M>
+    static BitMatrix fromRows(const M &mat) {
+        BitMatrix packed(mat.n_rows, mat.n_cols);
+        for (std::size_t c = 0; c < mat.n_cols; c++) {
+            for (std::size_t r = 0; r < mat.n_rows; r++) {
+                if (mat.at(r, c) != 0) {
+                    packed.set(r, c);
+                }
+            }
+        }
+        return packed;
+    }
+
+    inline uint64_t *row(std::size_t i) {
+        return data.data() + i * words;
+    }
+
+    inline const uint64_t *row(std::size_t i) const {
+        return data.data() + i * words;
+    }
+
+    inline void set(std::size_t i, std::size_t bit) {
+        row(i)[bit >> 6] |= uint64_t(1) << (bit & 63);
+    }
+
+    inline bool test(std::size_t i, std::size_t bit) const {
+        return (row(i)[bit >> 6] >> (bit & 63)) & 1;
+    }
+
+    std::vector<uint32_t> rowCounts() const {
+        return view().rowCounts();
+    }
+
+    inline BitMatrixView view() const {
+        return BitMatrixView(data.data(), rows, bits);
+    }
+
+    inline operator BitMatrixView() const {
+        return view();
+    }
+
+    inline std::size_t nRows() const { return rows; }
+
+    inline std::size_t nBits() const { return bits; }
+
+    inline std::size_t nWords() const { return words; }
+
+private:
+    std::size_t rows;
+    std::size_t bits;
+    std::size_t words;
+    std::vector<uint64_t, AlignedAllocator<uint64_t>> data;
+};
+
+#endif //ENTITYRESOLUTION_BITMATRIX_H
@@ -0,0 +1,198 @@
+//
+// Created by root on 10/16/26.
+//
+
+#ifndef ENTITYRESOLUTION_BUCKETMERGE_H
+#define ENTITYRESOLUTION_BUCKETMERGE_H
+
+#include <stdint.h>
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "BitKernels.h"
+#include "Parallel.h"
+
+/**
+ * Dense integer IDs for party and cluster names, handed out in first seen order
+ */
+class IdInterner {
+public:
+    inline uint32_t intern(const std::string &name) {
+        auto found = ids.find(name);
+        if (found != ids.end()) {
+            return found->second;
+        }
+        uint32_t id = names.size();
+        ids.emplace(name, id);
+        names.push_back(name);
+        return id;
+    }
+
+    /**
+     * @return ID of a known name, or size() if the name was never interned
+     */
+    inline uint32_t lookup(const std::string &name) const {
+        auto found = ids.find(name);
+        return found == ids.end() ? names.size() : found->second;
+    }
+
+    inline const std::string &name(uint32_t id) const {
+        return names[id];
+    }
+
+    inline std::size_t size() const { return names.size(); }
+
+private:
+    std::unordered_map<std::string, uint32_t> ids;
+    std::vector<std::string> names;
+};
+
+/**
+ * One cluster of one party landing in one LSH bucket
+ */
+struct BucketEntry {
+    uint64_t bucket;
+    uint32_t party;
+    uint32_t cluster;
+
+    inline bool operator<(const BucketEntry &other) const {
+        if (bucket != other.bucket) {
+            return bucket < other.bucket;
+        }
+        if (party != other.party) {
+            return party < other.party;
+        }
+        return cluster < other.cluster;
+    }
+
+    inline bool operator==(const BucketEntry &other) const {
+        return bucket == other.bucket && party == other.party && cluster == other.cluster;
+    }
+};
+
+/**
+ * Merged buckets in compressed form: bucket i has key keys[i] and its distinct (party, cluster) members are
+ * members[offsets[i]] .. members[offsets[i + 1]], sorted by party then cluster.
+ *
+ * The parties present in bucket i are kept as a bitmask of maskWords words at partyMask(i): a single word for
+ * up to 64 parties, more words only when there are more parties. Quorum checks are a popcount of that mask, so
+ * the threshold can change at runtime without touching the members.
+ */
+struct MergedBuckets {
+    struct Member {
+        uint32_t party;
+        uint32_t cluster;
+    };
+
+    std::vector<uint64_t> keys;
+    std::vector<std::size_t> offsets{0};
+    std::vector<Member> members;
+    std::size_t maskWords = 1;
+    std::vector<uint64_t> partyMasks;
+
+    inline std::size_t size() const { return keys.size(); }
+
+    inline const Member *begin(std::size_t i) const { return members.data() + offsets[i]; }
+
+    inline const Member *end(std::size_t i) const { return members.data() + offsets[i + 1]; }
+
+    inline const uint64_t *partyMask(std::size_t i) const {
+        return partyMasks.data() + i * maskWords;
+    }
+
+    inline bool hasParty(std::size_t i, uint32_t party) const {
+        return (partyMask(i)[party >> 6] >> (party & 63)) & 1;
+    }
+
+    inline uint32_t partyCount(std::size_t i) const {
+        return maskWords == 1 ? __builtin_popcountll(partyMasks[i]) : popcountWords(partyMask(i), maskWords);
+    }
+
+    inline bool hasQuorum(std::size_t i, uint32_t minParties) const {
+        return partyCount(i) >= minParties;
+    }
+
+    /**
+     * Buckets holding clusters of at least minParties parties
+     * @return Indices of those buckets in ascending key order
+     */
+    std::vector<std::size_t> withQuorum(uint32_t minParties) const {
+        std::vector<std::size_t> kept;
+        for (std::size_t i = 0; i < size(); i++) {
+            if (hasQuorum(i, minParties)) {
+                kept.push_back(i);
+            }
+        }
+        return kept;
+    }
+};
+
+/**
+ * Coordinator side merge of the LSH buckets reported by every party (and every worker of a party). Entries are
+ * collected as flat (bucket, party, cluster) tuples and merged by sorting, so the cost is one parallel sort and
+ * one linear pass however the entries are spread over buckets.
+ */
+class BucketMerger {
+public:
+    explicit BucketMerger(unsigned threads = 0) : threads(threads) {}
+
+    inline void reserve(std::size_t entries) {
+        this->entries.reserve(entries);
+    }
+
+    inline void add(uint64_t bucket, uint32_t party, uint32_t cluster) {
+        entries.push_back({bucket, party, cluster});
+    }
+
+    inline std::size_t size() const { return entries.size(); }
+
+    /**
+     * Merge the collected entries, dropping duplicates
+     * @param minParties Keep only buckets holding clusters of at least this many distinct parties, 1 keeps all
+     * so the quorum can be applied later with MergedBuckets::withQuorum
+     * @return Kept buckets in ascending key order
+     */
+    MergedBuckets merge(uint32_t minParties) {
+        parallelSort(entries, [](const BucketEntry &a, const BucketEntry &b) { return a < b; }, threads);
+
+        MergedBuckets merged;
+        uint32_t partyBound = 0;
+        for (const BucketEntry &entry: entries) {
+            partyBound = std::max(partyBound, entry.party + 1);
+        }
+        merged.maskWords = std::max<std::size_t>(1, (partyBound + 63) / 64);
+        std::vector<uint64_t> mask(merged.maskWords);
+
+        std::size_t n = entries.size();
+        for (std::size_t begin = 0, end; begin < n; begin = end) {
+            //Collect the parties of this bucket first, so dropped buckets cost no output
+            std::fill(mask.begin(), mask.end(), 0);
+            for (end = begin; end < n && entries[end].bucket == entries[begin].bucket; end++) {
+                mask[entries[end].party >> 6] |= uint64_t(1) << (entries[end].party & 63);
+            }
+            if (popcountWords(mask.data(), mask.size()) < minParties) {
+                continue;
+            }
+            merged.keys.push_back(entries[begin].bucket);
+            merged.partyMasks.insert(merged.partyMasks.end(), mask.begin(), mask.end());
+            for (std::size_t e = begin; e < end; e++) {
+                if (e == begin || !(entries[e] == entries[e - 1])) {
+                    merged.members.push_back({entries[e].party, entries[e].cluster});
+                }
+            }
+            merged.offsets.push_back(merged.members.size());
+        }
+        return merged;
+    }
+
+    void clear() {
+        entries.clear();
+    }
+
+private:
+    unsigned threads;
+    std::vector<BucketEntry> entries;
+};
+
+#endif //ENTITYRESOLUTION_BUCKETMERGE_H
@@ -0,0 +1,135 @@
+//
+// Created by root on 10/16/26.
+//
+
+#ifndef ENTITYRESOLUTION_CLUSTERPARTITIONER_H
+#define ENTITYRESOLUTION_CLUSTERPARTITIONER_H
+
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <vector>
+#include "BitMatrix.h"
+#include "FilterStore.h"
+#include "Parallel.h"
+
+/**
+ * Filters grouped by cluster: cluster c holds rows offsets[c] .. offsets[c + 1] of both matrices, in their
+ * original order, and ids[r] is the entity of row r
+ */
+struct ClusterPartition {
+    std::vector<std::size_t> offsets{0};
+    std::vector<int64_t> ids;
+    BitMatrix attrFilters;
+    BitMatrix structFilters;
+
+    inline std::size_t size() const { return offsets.size() - 1; }
+
+    inline std::size_t clusterSize(std::size_t c) const { return offsets[c + 1] - offsets[c]; }
+
+    inline BitMatrixView attrCluster(std::size_t c) const {
+        return attrFilters.view().rowRange(offsets[c], offsets[c + 1]);
+    }
+
+    inline BitMatrixView structCluster(std::size_t c) const {
+        return structFilters.view().rowRange(offsets[c], offsets[c + 1]);
+    }
+
+    inline const int64_t *clusterIds(std::size_t c) const { return ids.data() + offsets[c]; }
+};
+
+/**
+ * Groups filters by their cluster prediction in one counting sort pass. The predictions are split into fixed
+ * blocks, each block counts its clusters, and an exclusive scan over (cluster, block) gives every block its own
+ * write position in every cluster, so blocks scatter attribute filters, structural filters and IDs concurrently
+ * and the result is the same stable order whatever the number of threads.
+ */
+class ClusterPartitioner {
+public:
+    explicit ClusterPartitioner(unsigned threads = 0) : threads(threads == 0 ? hardwareThreads() : threads) {}
+
+    /**
+     * @param attrFilters Attribute filters, one per row
+     * @param structFilters Structural filters of the same entities
+     * @param ids Entity ID of every row
+     * @param pred Cluster of every row
+     * @param clusterCount Number of clusters, rows predicted outside [0, clusterCount) are dropped
+     */
+    ClusterPartition partition(const BitMatrixView &attrFilters, const BitMatrixView &structFilters,
+                               const int64_t *ids, const std::vector<uint16_t> &pred, uint16_t clusterCount) const {
+        std::size_t n = pred.size();
+        std::size_t blocks = std::max<std::size_t>(1, std::min<std::size_t>(threads * 4, (n + 4095) / 4096));
+        std::vector<std::size_t> counts(blocks * clusterCount, 0);
+        parallelFor(0, blocks, 1, [&](std::size_t block, std::size_t) {
+            std::size_t *blockCounts = counts.data() + block * clusterCount;
+            for (std::size_t i = n * block / blocks; i < n * (block + 1) / blocks; i++) {
+                if (pred[i] < clusterCount) {
+                    blockCounts[pred[i]]++;
+                }
+            }
+        }, threads);
+
+        //Exclusive scan in (cluster, block) order, turning counts into write positions
+        ClusterPartition result;
+        result.offsets.assign(clusterCount + 1, 0);
+        std::size_t position = 0;
+        for (uint16_t c = 0; c < clusterCount; c++) {
+            result.offsets[c] = position;
+            for (std::size_t block = 0; block < blocks; block++) {
+                std::size_t count = counts[block * clusterCount + c];
+                counts[block * clusterCount + c] = position;
+                position += count;
+            }
+        }
+        result.offsets[clusterCount] = position;
+
+        std::size_t words = attrFilters.nWords();
+        result.ids.resize(position);
+        result.attrFilters = BitMatrix(position, attrFilters.nBits());
+        result.structFilters = BitMatrix(position, structFilters.nBits());
+        parallelFor(0, blocks, 1, [&](std::size_t block, std::size_t) {
+            std::size_t *fill = counts.data() + block * clusterCount;
+            for (std::size_t i = n * block / blocks; i < n * (block + 1) / blocks; i++) {
+                if (pred[i] >= clusterCount) {
+                    continue;
+                }
+                std::size_t to = fill[pred[i]]++;
+                result.ids[to] = ids[i];
+                std::copy(attrFilters.row(i), attrFilters.row(i) + words, result.attrFilters.row(to));
+                std::copy(structFilters.row(i), structFilters.row(i) + structFilters.nWords(),
+                          result.structFilters.row(to));
+            }
+        }, threads);
+        return result;
+    }
+
+    /**
+     * Write every cluster block as its own filter file, "<prefix><cluster>.bin", all files in parallel
+     * @return false if any file could not be written
+     */
+    bool save(const ClusterPartition &partition, const std::string &attrPrefix,
+              const std::string &structPrefix) const {
+        std::atomic<bool> ok(true);
+        parallelFor(0, 2 * partition.size(), 1, [&](std::size_t file, std::size_t) {
+            std::size_t c = file / 2;
+            bool attr = file % 2 == 0;
+            BitMatrixView rows = attr ? partition.attrCluster(c) : partition.structCluster(c);
+            FilterStoreWriter writer;
+            if (!writer.open((attr ? attrPrefix : structPrefix) + std::to_string(c) + ".bin", rows.nBits())) {
+                ok = false;
+                return;
+            }
+            writer.append(partition.clusterIds(c), rows);
+            if (!writer.close()) {
+                ok = false;
+            }
+        }, threads);
+        return ok;
+    }
+
+private:
+    unsigned threads;
+};
+
+#endif //ENTITYRESOLUTION_CLUSTERPARTITIONER_H
@@ -0,0 +1,335 @@
+//
+// Created by root on 10/16/26.
+//
+
+#ifndef ENTITYRESOLUTION_ENTITYGRAPH_H
+#define ENTITYRESOLUTION_ENTITYGRAPH_H
+
+#include <stdint.h>
+#include <algorithm>
+#include <charconv>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "MappedFile.h"
+#include "Parallel.h"
+
+/*
+ * Text input of the pipeline, both files are parsed in place from a memory mapping:
+ *
+ *   entity file: one entity per line, "id attr attr ...", fields separated by spaces
+ *   edge file:   one edge per line, "from to"
+ *
+ * Blank lines are skipped anywhere in the file, as are lines whose first field is not an integer. The buffer is
+ * cut into one chunk per thread at line boundaries and the chunks are parsed concurrently with from_chars.
+ */
+
+/**
+ * Start of every parse chunk of a buffer, chunk c covering [starts[c], starts[c + 1]), each starting a line
+ */
+inline std::vector<std::size_t> lineChunks(const char *data, std::size_t size, unsigned chunks) {
+    std::vector<std::size_t> starts(1, 0);
+    for (unsigned c = 1; c < chunks; c++) {
+        std::size_t pos = std::max(starts.back(), size * c / chunks);
+        while (pos < size && pos > 0 && data[pos - 1] != '\n') {
+            pos++;
+        }
+        starts.push_back(pos);
+    }
+    starts.push_back(size);
+    return starts;
+}
+
+inline bool isFieldSeparator(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+/**
+ * Attributes of all entities, parsed without copying: every attribute is an offset and a length into the input
+ * buffer, which acts as the arena. Row i is the entity with the i-th smallest ID; for an ID listed more than once
+ * the last line wins.
+ */
+class EntityTable {
+public:
+    EntityTable() : base(nullptr), bytes(0) {}
+
+    EntityTable(const EntityTable &) = delete;
+
+    EntityTable &operator=(const EntityTable &) = delete;
+
+    EntityTable(EntityTable &&) = default;
+
+    EntityTable &operator=(EntityTable &&) = default;
+
+    /**
+     * Map and parse an entity file, the mapping stays alive with the table
+     * @return false if the file could not be mapped
+     */
+    bool load(const std::string &path, unsigned threads = 0) {
+        if (!file.open(path)) {
+            return false;
+        }
+        parse(file.data(), file.size(), threads);
+        return true;
+    }
+
+    /**
+     * Parse entities from a buffer that outlives the table
+     */
+    void parse(const char *data, std::size_t size, unsigned threads = 0) {
+        base = data;
+        bytes = size;
+        if (threads == 0) {
+            threads = hardwareThreads();
+        }
+
+        //Entities of each chunk in file order
+        struct Parsed {
+            std::vector<int64_t> ids;
+            std::vector<uint32_t> fieldCounts;
+            std::vector<uint64_t> fieldOffsets;
+            std::vector<uint32_t> fieldLengths;
+        };
+        std::vector<std::size_t> starts = lineChunks(data, size, threads);
+        std::vector<Parsed> parsed(starts.size() - 1);
+        parallelFor(0, parsed.size(), 1, [&](std::size_t c, std::size_t) {
+            Parsed &out = parsed[c];
+            const char *pos = data + starts[c];
+            const char *chunkEnd = data + starts[c + 1];
+            while (pos < chunkEnd) {
+                const char *lineEnd = std::find(pos, chunkEnd, '\n');
+                while (pos < lineEnd && isFieldSeparator(*pos)) {
+                    pos++;
+                }
+                int64_t id;
+                auto result = std::from_chars(pos, lineEnd, id);
+                if (result.ec == std::errc()) {
+                    uint32_t fields = 0;
+                    for (pos = result.ptr; pos < lineEnd;) {
+                        while (pos < lineEnd && isFieldSeparator(*pos)) {
+                            pos++;
+                        }
+                        const char *fieldBegin = pos;
+                        while (pos < lineEnd && !isFieldSeparator(*pos)) {
+                            pos++;
+                        }
+                        if (pos > fieldBegin) {
+                            out.fieldOffsets.push_back(fieldBegin - data);
+                            out.fieldLengths.push_back(pos - fieldBegin);
+                            fields++;
+                        }
+                    }
+                    out.ids.push_back(id);
+                    out.fieldCounts.push_back(fields);
+                }
+                pos = lineEnd + 1;
+            }
+        }, threads);
+
+        //File order index of every entity and where its fields start
+        struct Line {
+            int64_t id;
+            uint64_t order;
+            uint64_t firstField;
+            uint32_t fields;
+        };
+        std::vector<Line> lines;
+        uint64_t field = 0;
+        for (const Parsed &chunk: parsed) {
+            for (std::size_t e = 0; e < chunk.ids.size(); e++) {
+                lines.push_back({chunk.ids[e], lines.size(), field, chunk.fieldCounts[e]});
+                field += chunk.fieldCounts[e];
+            }
+        }
+        std::vector<uint64_t> allOffsets;
+        std::vector<uint32_t> allLengths;
+        allOffsets.reserve(field);
+        allLengths.reserve(field);
+        for (const Parsed &chunk: parsed) {
+            allOffsets.insert(allOffsets.end(), chunk.fieldOffsets.begin(), chunk.fieldOffsets.end());
+            allLengths.insert(allLengths.end(), chunk.fieldLengths.begin(), chunk.fieldLengths.end());
+        }
+
+        //Order by ID, the last line of a repeated ID wins
+        parallelSort(lines, [](const Line &a, const Line &b) {
+            return a.id != b.id ? a.id < b.id : a.order < b.order;
+        }, threads);
+        ids.clear();
+        attrBegin.assign(1, 0);
+        fieldOffsets.clear();
+        fieldLengths.clear();
+        for (std::size_t l = 0; l < lines.size(); l++) {
+            if (l + 1 < lines.size() && lines[l + 1].id == lines[l].id) {
+                continue;
+            }
+            ids.push_back(lines[l].id);
+            fieldOffsets.insert(fieldOffsets.end(), allOffsets.begin() + lines[l].firstField,
+                                allOffsets.begin() + lines[l].firstField + lines[l].fields);
+            fieldLengths.insert(fieldLengths.end(), allLengths.begin() + lines[l].firstField,
+                                allLengths.begin() + lines[l].firstField + lines[l].fields);
+            attrBegin.push_back(fieldOffsets.size());
+        }
+
+        //Direct row index when the IDs are dense enough, binary search otherwise
+        rowIndex.clear();
+        if (!ids.empty() && (uint64_t) (ids.back() - ids.front()) < 4 * (uint64_t) ids.size() + 1024) {
+            rowIndex.assign(ids.back() - ids.front() + 1, -1);
+            for (std::size_t r = 0; r < ids.size(); r++) {
+                rowIndex[ids[r] - ids.front()] = r;
+            }
+        }
+    }
+
+    inline std::size_t size() const { return ids.size(); }
+
+    inline int64_t id(std::size_t row) const { return ids[row]; }
+
+    inline const std::vector<int64_t> &allIds() const { return ids; }
+
+    /**
+     * Size of the parsed input
+     */
+    inline std::size_t inputBytes() const { return bytes; }
+
+    inline std::size_t attributeCount(std::size_t row) const {
+        return attrBegin[row + 1] - attrBegin[row];
+    }
+
+    inline std::string_view attribute(std::size_t row, std::size_t k) const {
+        std::size_t field = attrBegin[row] + k;
+        return std::string_view(base + fieldOffsets[field], fieldLengths[field]);
+    }
+
+    /**
+     * Row of an entity ID
+     * @return Row, or -1 if the ID is unknown
+     */
+    inline long row(int64_t entityId) const {
+        if (!rowIndex.empty()) {
+            uint64_t slot = (uint64_t) (entityId - ids.front());
+            return slot < rowIndex.size() ? rowIndex[slot] : -1;
+        }
+        auto found = std::lower_bound(ids.begin(), ids.end(), entityId);
+        return found != ids.end() && *found == entityId ? found - ids.begin() : -1;
+    }
+
+private:
+    MappedFile file;
+    const char *base;
+    std::size_t bytes;
+    std::vector<int64_t> ids;
+    std::vector<std::size_t> attrBegin{0};
+    std::vector<uint64_t> fieldOffsets;
+    std::vector<uint32_t> fieldLengths;
+    std::vector<int32_t> rowIndex;
+};
+
+/**
+ * Directed adjacency in compressed sparse row form over entity rows: the neighbours of row v are
+ * neighbours[offsets[v]] .. neighbours[offsets[v + 1]], in edge file order
+ */
+class CsrGraph {
+public:
+    CsrGraph() : bytes(0), offsets(1, 0) {}
+
+    /**
+     * Map and parse an edge file
+     * @param path Edge file
+     * @param entities Entities the edge endpoints are resolved against, edges touching unknown IDs are dropped
+     * @return false if the file could not be mapped
+     */
+    bool load(const std::string &path, const EntityTable &entities, unsigned threads = 0) {
+        MappedFile file;
+        if (!file.open(path)) {
+            return false;
+        }
+        parse(file.data(), file.size(), entities, threads);
+        return true;
+    }
+
+    void parse(const char *data, std::size_t size, const EntityTable &entities, unsigned threads = 0) {
+        bytes = size;
+        if (threads == 0) {
+            threads = hardwareThreads();
+        }
+
+        //Edges of each chunk as row pairs, in file order
+        std::vector<std::size_t> starts = lineChunks(data, size, threads);
+        std::vector<std::vector<std::pair<uint32_t, uint32_t>>> parsed(starts.size() - 1);
+        parallelFor(0, parsed.size(), 1, [&](std::size_t c, std::size_t) {
+            const char *pos = data + starts[c];
+            const char *chunkEnd = data + starts[c + 1];
+            while (pos < chunkEnd) {
+                const char *lineEnd = std::find(pos, chunkEnd, '\n');
+                int64_t vertex[2];
+                bool complete = true;
+                for (int v = 0; v < 2 && complete; v++) {
+                    while (pos < lineEnd && isFieldSeparator(*pos)) {
+                        pos++;
+                    }
+                    auto result = std::from_chars(pos, lineEnd, vertex[v]);
+                    complete = result.ec == std::errc();
+                    pos = result.ptr;
+                }
+                if (complete) {
+                    long from = entities.row(vertex[0]);
+                    long to = entities.row(vertex[1]);
+                    if (from >= 0 && to >= 0) {
+                        parsed[c].push_back({(uint32_t) from, (uint32_t) to});
+                    }
+                }
+                pos = lineEnd + 1;
+            }
+        }, threads);
+
+        build(entities.size(), parsed);
+    }
+
+    /**
+     * Build from edge lists given as row pairs, concatenated in order
+     */
+    void build(std::size_t vertices, const std::vector<std::vector<std::pair<uint32_t, uint32_t>>> &edges) {
+        //Counting sort by source row, stable so neighbours keep their edge order
+        offsets.assign(vertices + 1, 0);
+        for (const auto &chunk: edges) {
+            for (const auto &edge: chunk) {
+                offsets[edge.first + 1]++;
+            }
+        }
+        for (std::size_t v = 0; v < vertices; v++) {
+            offsets[v + 1] += offsets[v];
+        }
+        neighbours.resize(offsets[vertices]);
+        std::vector<uint64_t> fill(offsets.begin(), offsets.end() - 1);
+        for (const auto &chunk: edges) {
+            for (const auto &edge: chunk) {
+                neighbours[fill[edge.first]++] = edge.second;
+            }
+        }
+    }
+
+    inline std::size_t size() const { return offsets.size() - 1; }
+
+    inline std::size_t edgeCount() const { return neighbours.size(); }
+
+    /**
+     * Size of the parsed input, 0 if built from edge lists
+     */
+    inline std::size_t inputBytes() const { return bytes; }
+
+    inline std::size_t degree(std::size_t v) const {
+        return offsets[v + 1] - offsets[v];
+    }
+
+    inline const uint32_t *begin(std::size_t v) const { return neighbours.data() + offsets[v]; }
+
+    inline const uint32_t *end(std::size_t v) const { return neighbours.data() + offsets[v + 1]; }
+
+private:
+    std::size_t bytes;
+    std::vector<uint64_t> offsets;
+    std::vector<uint32_t> neighbours;
+};
+
+#endif //ENTITYRESOLUTION_ENTITYGRAPH_H
@@ -0,0 +1,199 @@
+//
+// Created by root on 10/16/26.
+//
+
+#ifndef ENTITYRESOLUTION_ENTITYRESOLVER_H
+#define ENTITYRESOLUTION_ENTITYRESOLVER_H
+
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+#include "LinkTable.h"
+#include "Parallel.h"
+
+/**
+ * Union-find over a fixed number of elements that can be updated from many threads at once. Finds halve the
+ * path with compare-and-swap, unions hang the larger root under the smaller one with a single compare-and-swap
+ * and retry if another thread got there first, so no locks are taken and the final root of every set is its
+ * smallest element whatever the interleaving.
+ */
+class ConcurrentUnionFind {
+public:
+    explicit ConcurrentUnionFind(std::size_t size) : parent(size) {
+        for (std::size_t i = 0; i < size; i++) {
+            parent[i].store(i, std::memory_order_relaxed);
+        }
+    }
+
+    uint32_t find(uint32_t x) {
+        while (true) {
+            uint32_t up = parent[x].load(std::memory_order_relaxed);
+            if (up == x) {
+                return x;
+            }
+            uint32_t grand = parent[up].load(std::memory_order_relaxed);
+            if (grand != up) {
+                //Path halving, losing the race only means the path stays a little longer
+                parent[x].compare_exchange_weak(up, grand, std::memory_order_relaxed);
+            }
+            x = grand;
+        }
+    }
+
+    void unite(uint32_t a, uint32_t b) {
+        while (true) {
+            a = find(a);
+            b = find(b);
+            if (a == b) {
+                return;
+            }
+            if (a > b) {
+                std::swap(a, b);
+            }
+            uint32_t expected = b;
+            if (parent[b].compare_exchange_strong(expected, a, std::memory_order_acq_rel)) {
+                return;
+            }
+        }
+    }
+
+    inline std::size_t size() const { return parent.size(); }
+
+private:
+    std::vector<std::atomic<uint32_t>> parent;
+};
+
+/**
+ * Links found between two parties, entity i of fromParty linked to entity links->get(i) of toParty
+ */
+struct PartyLinks {
+    uint32_t fromParty;
+    uint32_t toParty;
+    const LinkTable *links;
+};
+
+/**
+ * Resolved common entities: group g holds the (party, entity) members members[offsets[g]] ..
+ * members[offsets[g + 1]], ordered by party then entity
+ */
+struct EntityGroups {
+    struct Member {
+        uint32_t party;
+        uint32_t entity;
+    };
+
+    std::vector<std::size_t> offsets{0};
+    std::vector<Member> members;
+    //Number of distinct parties in each group
+    std::vector<uint32_t> partyCounts;
+
+    inline std::size_t size() const { return offsets.size() - 1; }
+
+    inline const Member *begin(std::size_t g) const { return members.data() + offsets[g]; }
+
+    inline const Member *end(std::size_t g) const { return members.data() + offsets[g + 1]; }
+};
+
+/**
+ * Multi-party common entity resolution. Every entity of every party is a node, every pairwise link an edge, and
+ * the connected components are the common entities, so an entity missing one pairwise link is still grouped
+ * through the others. Links are united in parallel, components are then collected with a counting sort on their
+ * roots, keeping the whole resolution near linear in the number of entities and links. The total number of
+ * entities over all parties has to fit in 32 bits.
+ */
+class EntityResolver {
+public:
+    /**
+     * @param partySizes Number of entities of each party
+     * @param threads Number of threads, 0 for hardwareThreads()
+     */
+    explicit EntityResolver(const std::vector<uint32_t> &partySizes, unsigned threads = 0)
+            : threads(threads == 0 ? hardwareThreads() : threads), offsets(partySizes.size() + 1, 0) {
+        for (std::size_t p = 0; p < partySizes.size(); p++) {
+            offsets[p + 1] = offsets[p] + partySizes[p];
+        }
+    }
+
+    /**
+     * Group linked entities across parties
+     * @param allLinks Pairwise link tables, in any direction and between any parties
+     * @param minParties Keep only groups with entities of at least this many distinct parties
+     * @return Groups ordered by their smallest member
+     */
+    EntityGroups resolve(const std::vector<PartyLinks> &allLinks, uint32_t minParties) const {
+        std::size_t nodes = offsets.back();
+        ConcurrentUnionFind components(nodes);
+
+        for (const PartyLinks &pairLinks: allLinks) {
+            uint64_t fromOffset = offsets[pairLinks.fromParty];
+            uint64_t toOffset = offsets[pairLinks.toParty];
+            std::size_t fromSize = offsets[pairLinks.fromParty + 1] - fromOffset;
+            std::size_t toSize = offsets[pairLinks.toParty + 1] - toOffset;
+            const LinkTable &links = *pairLinks.links;
+            parallelFor(0, std::min(links.size(), fromSize), 1 << 14, [&](std::size_t begin, std::size_t end) {
+                for (std::size_t entity = begin; entity < end; entity++) {
+                    uint32_t other = links.get(entity);
+                    if (other != NoLink && other < toSize) {
+                        components.unite(fromOffset + entity, toOffset + other);
+                    }
+                }
+            }, threads);
+        }
+
+        //Flatten to roots, then bucket the nodes by root with a counting sort
+        std::vector<uint32_t> roots(nodes);
+        parallelFor(0, nodes, 1 << 14, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t node = begin; node < end; node++) {
+                roots[node] = components.find(node);
+            }
+        }, threads);
+        std::vector<uint32_t> starts(nodes + 1, 0);
+        for (uint32_t root: roots) {
+            starts[root + 1]++;
+        }
+        for (std::size_t node = 0; node < nodes; node++) {
+            starts[node + 1] += starts[node];
+        }
+        std::vector<uint32_t> sorted(nodes);
+        std::vector<uint32_t> fill(starts.begin(), starts.end() - 1);
+        for (std::size_t node = 0; node < nodes; node++) {
+            sorted[fill[roots[node]]++] = node;
+        }
+
+        //Nodes of a component are in ascending order, so parties are too
+        EntityGroups groups;
+        for (std::size_t root = 0; root < nodes; root++) {
+            if (roots[root] != root) {
+                continue;
+            }
+            uint32_t parties = 0;
+            uint32_t lastParty = 0;
+            for (uint32_t s = starts[root]; s < starts[root + 1]; s++) {
+                uint32_t party = partyOf(sorted[s]);
+                parties += s == starts[root] || party != lastParty;
+                lastParty = party;
+            }
+            if (parties < minParties) {
+                continue;
+            }
+            for (uint32_t s = starts[root]; s < starts[root + 1]; s++) {
+                uint32_t party = partyOf(sorted[s]);
+                groups.members.push_back({party, (uint32_t) (sorted[s] - offsets[party])});
+            }
+            groups.offsets.push_back(groups.members.size());
+            groups.partyCounts.push_back(parties);
+        }
+        return groups;
+    }
+
+private:
+    inline uint32_t partyOf(uint32_t node) const {
+        return std::upper_bound(offsets.begin(), offsets.end(), (uint64_t) node) - offsets.begin() - 1;
+    }
+
+    unsigned threads;
+    std::vector<uint64_t> offsets;
+};
+
+#endif //ENTITYRESOLUTION_ENTITYRESOLVER_H
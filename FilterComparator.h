@@ -0,0 +1,425 @@
+//
+// Created by root on 10/16/26.
+//
+
+#ifndef ENTITYRESOLUTION_FILTERCOMPARATOR_H
+#define ENTITYRESOLUTION_FILTERCOMPARATOR_H
+
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <vector>
+#include "BitMatrix.h"
+#include "Parallel.h"
+
+/**
+ * Candidate pair of clusters from the LSH stage, by index into the self and other cluster lists
+ */
+struct ClusterPair {
+    uint32_t self;
+    uint32_t other;
+};
+
+/**
+ * Most similar other filter of one self filter within a cluster pair
+ */
+struct FilterMatch {
+    uint32_t pair;
+    uint32_t selfRow;
+    uint32_t otherRow;
+    float score;
+};
+
+/**
+ * How candidates are turned into one-to-one links within a cluster pair
+ */
+enum class AssignmentMode {
+    //Highest scoring candidate links first, skipping filters already linked
+    Greedy,
+    //Auction algorithm, maximizes the total score of the links up to eps per link
+    Auction
+};
+
+/**
+ * Cross-party filter comparison over many candidate cluster pairs. Every self filter of a pair is scored against
+ * every other filter of the pair with the Dice coefficient and keeps its best match (first one on ties) if it
+ * beats the threshold, as compareFilters does for a single pair.
+ *
+ * Work is cut into tiles of tileRows self filters of one pair, handed out to threads dynamically so large and
+ * small clusters balance out. Within a tile the other cluster is walked in blocks of tileRows filters that stay
+ * in L1 while every self filter of the tile is compared against them. Set bit counts of every filter are
+ * computed once per cluster, so a comparison costs a single popcount of the AND.
+ *
+ * candidates() instead keeps a bounded heap of the topK best other filters above the threshold for every self
+ * filter during the same sweep, and assign() turns those into one-to-one links so that two self filters never
+ * claim the same other filter.
+ */
+class FilterComparator {
+public:
+    /**
+     * @param similarityThreshold Dice coefficient a match has to beat
+     * @param threads Number of threads, 0 for hardwareThreads()
+     * @param tileRows Self filters per task and other filters per block
+     * @param topK Candidates kept per self filter by candidates()
+     */
+    FilterComparator(float similarityThreshold = 0.9, unsigned threads = 0, std::size_t tileRows = 64,
+                     uint16_t topK = 4)
+            : similarityThreshold(similarityThreshold),
+              threads(threads == 0 ? hardwareThreads() : threads),
+              tileRows(tileRows == 0 ? 1 : tileRows),
+              topK(topK == 0 ? 1 : topK),
+              lastComparisons(0),
+              lastSeconds(0) {}
+
+    /**
+     * Compare the filters of every candidate pair
+     * @param selfClusters Packed filters of each self cluster
+     * @param otherClusters Packed filters of each other cluster, same filter length
+     * @param pairs Candidate pairs
+     * @return Best match of every self filter above the threshold, ordered by pair then self row
+     */
+    std::vector<FilterMatch> compare(const std::vector<BitMatrixView> &selfClusters,
+                                     const std::vector<BitMatrixView> &otherClusters,
+                                     const std::vector<ClusterPair> &pairs) {
+        return sweep(selfClusters, otherClusters, pairs, 1);
+    }
+
+    /**
+     * Compare the filters of every candidate pair keeping the topK best matches of each self filter
+     * @return Matches above the threshold, ordered by pair, self row, then descending score (lower other row
+     * first on ties)
+     */
+    std::vector<FilterMatch> candidates(const std::vector<BitMatrixView> &selfClusters,
+                                        const std::vector<BitMatrixView> &otherClusters,
+                                        const std::vector<ClusterPair> &pairs) {
+        return sweep(selfClusters, otherClusters, pairs, topK);
+    }
+
+    /**
+     * Pick one-to-one links out of the candidates of each pair
+     * @param candidates Output of candidates(), grouped by pair
+     * @param mode Greedy by score or auction
+     * @param eps Minimum bid increment of the auction, the total score is optimal within eps per link
+     * @return Links ordered by pair then self row, each self and other filter of a pair used at most once
+     */
+    std::vector<FilterMatch> assign(const std::vector<FilterMatch> &candidates, AssignmentMode mode,
+                                    float eps = 1e-4f) const {
+        //Pairs are independent, assign each group concurrently
+        std::vector<std::size_t> groups;
+        for (std::size_t c = 0; c < candidates.size(); c++) {
+            if (c == 0 || candidates[c].pair != candidates[c - 1].pair) {
+                groups.push_back(c);
+            }
+        }
+        groups.push_back(candidates.size());
+
+        std::vector<std::vector<FilterMatch>> groupLinks(groups.size() - 1);
+        parallelFor(0, groups.size() - 1, 1, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t g = begin; g < end; g++) {
+                const FilterMatch *first = candidates.data() + groups[g];
+                const FilterMatch *last = candidates.data() + groups[g + 1];
+                groupLinks[g] = mode == AssignmentMode::Greedy ? assignGreedy(first, last)
+                                                               : assignAuction(first, last, eps);
+            }
+        }, threads);
+
+        std::vector<FilterMatch> links;
+        for (const auto &found: groupLinks) {
+            links.insert(links.end(), found.begin(), found.end());
+        }
+        return links;
+    }
+
+    /**
+     * Filter pairs scored by the last compare()
+     */
+    inline uint64_t comparisonCount() const {
+        return lastComparisons;
+    }
+
+    /**
+     * Throughput of the last compare(), including the popcount precomputation
+     */
+    inline double comparisonsPerSecond() const {
+        return lastSeconds > 0 ? lastComparisons / lastSeconds : 0;
+    }
+
+private:
+    std::vector<FilterMatch> sweep(const std::vector<BitMatrixView> &selfClusters,
+                                   const std::vector<BitMatrixView> &otherClusters,
+                                   const std::vector<ClusterPair> &pairs, uint16_t keep) {
+        auto start = std::chrono::steady_clock::now();
+
+        //Set bit counts of only the clusters some pair refers to
+        std::vector<std::vector<uint32_t>> selfCounts(selfClusters.size());
+        std::vector<std::vector<uint32_t>> otherCounts(otherClusters.size());
+        std::vector<const BitMatrixView *> countSources;
+        std::vector<std::vector<uint32_t> *> countTargets;
+        std::vector<char> selfUsed(selfClusters.size(), 0);
+        std::vector<char> otherUsed(otherClusters.size(), 0);
+        for (const ClusterPair &pair: pairs) {
+            if (!selfUsed[pair.self]) {
+                selfUsed[pair.self] = 1;
+                countSources.push_back(&selfClusters[pair.self]);
+                countTargets.push_back(&selfCounts[pair.self]);
+            }
+            if (!otherUsed[pair.other]) {
+                otherUsed[pair.other] = 1;
+                countSources.push_back(&otherClusters[pair.other]);
+                countTargets.push_back(&otherCounts[pair.other]);
+            }
+        }
+        parallelFor(0, countSources.size(), 1, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t c = begin; c < end; c++) {
+                *countTargets[c] = countSources[c]->rowCounts();
+            }
+        }, threads);
+
+        //One task per tile of self filters
+        struct Tile {
+            uint32_t pair;
+            std::size_t selfBegin;
+            std::size_t selfEnd;
+        };
+        std::vector<Tile> tiles;
+        uint64_t comparisons = 0;
+        for (uint32_t p = 0; p < pairs.size(); p++) {
+            const BitMatrixView &self = selfClusters[pairs[p].self];
+            const BitMatrixView &other = otherClusters[pairs[p].other];
+            if (other.nRows() == 0) {
+                continue;
+            }
+            for (std::size_t begin = 0; begin < self.nRows(); begin += tileRows) {
+                tiles.push_back({p, begin, std::min(begin + tileRows, self.nRows())});
+            }
+            comparisons += (uint64_t) self.nRows() * other.nRows();
+        }
+
+        std::vector<std::vector<FilterMatch>> tileMatches(tiles.size());
+        parallelFor(0, tiles.size(), 1, [&](std::size_t begin, std::size_t end) {
+            std::vector<float> best(tileRows);
+            std::vector<uint32_t> bestIndex(tileRows);
+            std::vector<FilterMatch> heaps(tileRows * keep);
+            std::vector<uint16_t> heapSizes(tileRows);
+            for (std::size_t t = begin; t < end; t++) {
+                const Tile &tile = tiles[t];
+                const ClusterPair &pair = pairs[tile.pair];
+                if (keep > 1) {
+                    topTile(selfClusters[pair.self], selfCounts[pair.self], otherClusters[pair.other],
+                            otherCounts[pair.other], tile.selfBegin, tile.selfEnd, keep, heaps.data(),
+                            heapSizes.data());
+                    for (std::size_t i = tile.selfBegin; i < tile.selfEnd; i++) {
+                        FilterMatch *heap = heaps.data() + (i - tile.selfBegin) * keep;
+                        uint16_t size = heapSizes[i - tile.selfBegin];
+                        std::sort_heap(heap, heap + size, better);
+                        for (uint16_t h = 0; h < size; h++) {
+                            tileMatches[t].push_back({tile.pair, (uint32_t) i, heap[h].otherRow, heap[h].score});
+                        }
+                    }
+                    continue;
+                }
+                compareTile(selfClusters[pair.self], selfCounts[pair.self], otherClusters[pair.other],
+                            otherCounts[pair.other], tile.selfBegin, tile.selfEnd, best.data(), bestIndex.data());
+                for (std::size_t i = tile.selfBegin; i < tile.selfEnd; i++) {
+                    //Check if the most similar filter meets the similarity threshold
+                    if (best[i - tile.selfBegin] > similarityThreshold) {
+                        tileMatches[t].push_back({tile.pair, (uint32_t) i, bestIndex[i - tile.selfBegin],
+                                                  best[i - tile.selfBegin]});
+                    }
+                }
+            }
+        }, threads);
+
+        std::vector<FilterMatch> matches;
+        for (const auto &found: tileMatches) {
+            matches.insert(matches.end(), found.begin(), found.end());
+        }
+
+        lastComparisons = comparisons;
+        lastSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return matches;
+    }
+
+    /**
+     * Best other filter of every self filter in [selfBegin, selfEnd), other filters visited a block at a time
+     */
+    void compareTile(const BitMatrixView &self, const std::vector<uint32_t> &selfCounts,
+                     const BitMatrixView &other, const std::vector<uint32_t> &otherCounts,
+                     std::size_t selfBegin, std::size_t selfEnd, float *best, uint32_t *bestIndex) const {
+        std::size_t words = self.nWords();
+        std::fill(best, best + (selfEnd - selfBegin), -1.0f);
+        std::fill(bestIndex, bestIndex + (selfEnd - selfBegin), 0);
+        for (std::size_t blockBegin = 0; blockBegin < other.nRows(); blockBegin += tileRows) {
+            std::size_t blockEnd = std::min(blockBegin + tileRows, other.nRows());
+            for (std::size_t i = selfBegin; i < selfEnd; i++) {
+                const uint64_t *selfFilter = self.row(i);
+                uint32_t selfCount = selfCounts[i];
+                float &maxCoeff = best[i - selfBegin];
+                uint32_t &maxIndex = bestIndex[i - selfBegin];
+                for (std::size_t j = blockBegin; j < blockEnd; j++) {
+                    uint64_t intersection = popcountAnd(selfFilter, other.row(j), words);
+                    float diceCoeff = diceCoefficient(intersection, selfCount, otherCounts[j]);
+                    if (diceCoeff > maxCoeff) {
+                        maxCoeff = diceCoeff;
+                        maxIndex = j;
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * Ranking of candidates: higher score first, lower other row on ties
+     */
+    static inline bool better(const FilterMatch &a, const FilterMatch &b) {
+        return a.score > b.score || (a.score == b.score && a.otherRow < b.otherRow);
+    }
+
+    /**
+     * The keep best other filters above the threshold of every self filter in [selfBegin, selfEnd), each held
+     * in a heap with the weakest kept candidate on top
+     */
+    void topTile(const BitMatrixView &self, const std::vector<uint32_t> &selfCounts,
+                 const BitMatrixView &other, const std::vector<uint32_t> &otherCounts,
+                 std::size_t selfBegin, std::size_t selfEnd, uint16_t keep,
+                 FilterMatch *heaps, uint16_t *heapSizes) const {
+        std::size_t words = self.nWords();
+        std::fill(heapSizes, heapSizes + (selfEnd - selfBegin), 0);
+        for (std::size_t blockBegin = 0; blockBegin < other.nRows(); blockBegin += tileRows) {
+            std::size_t blockEnd = std::min(blockBegin + tileRows, other.nRows());
+            for (std::size_t i = selfBegin; i < selfEnd; i++) {
+                const uint64_t *selfFilter = self.row(i);
+                uint32_t selfCount = selfCounts[i];
+                FilterMatch *heap = heaps + (i - selfBegin) * keep;
+                uint16_t &size = heapSizes[i - selfBegin];
+                for (std::size_t j = blockBegin; j < blockEnd; j++) {
+                    uint64_t intersection = popcountAnd(selfFilter, other.row(j), words);
+                    float diceCoeff = diceCoefficient(intersection, selfCount, otherCounts[j]);
+                    if (diceCoeff <= similarityThreshold) {
+                        continue;
+                    }
+                    FilterMatch candidate = {0, (uint32_t) i, (uint32_t) j, diceCoeff};
+                    if (size < keep) {
+                        heap[size++] = candidate;
+                        std::push_heap(heap, heap + size, better);
+                    } else if (better(candidate, heap[0])) {
+                        std::pop_heap(heap, heap + size, better);
+                        heap[size - 1] = candidate;
+                        std::push_heap(heap, heap + size, better);
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * Accept candidate links from the highest score down while both filters are still free
+     */
+    static std::vector<FilterMatch> assignGreedy(const FilterMatch *first, const FilterMatch *last) {
+        std::vector<FilterMatch> edges(first, last);
+        std::sort(edges.begin(), edges.end(), [](const FilterMatch &a, const FilterMatch &b) {
+            if (a.score != b.score) {
+                return a.score > b.score;
+            }
+            return a.selfRow != b.selfRow ? a.selfRow < b.selfRow : a.otherRow < b.otherRow;
+        });
+
+        std::vector<FilterMatch> links;
+        std::vector<char> usedSelf;
+        std::vector<char> usedOther;
+        for (const FilterMatch &edge: edges) {
+            if (edge.selfRow >= usedSelf.size()) {
+                usedSelf.resize(edge.selfRow + 1, 0);
+            }
+            if (edge.otherRow >= usedOther.size()) {
+                usedOther.resize(edge.otherRow + 1, 0);
+            }
+            if (!usedSelf[edge.selfRow] && !usedOther[edge.otherRow]) {
+                usedSelf[edge.selfRow] = 1;
+                usedOther[edge.otherRow] = 1;
+                links.push_back(edge);
+            }
+        }
+        std::sort(links.begin(), links.end(), [](const FilterMatch &a, const FilterMatch &b) {
+            return a.selfRow < b.selfRow;
+        });
+        return links;
+    }
+
+    /**
+     * Forward auction (Bertsekas) over the sparse candidate graph. Every self filter may also stay unlinked at
+     * value 0, so a bid is only placed while some other filter is worth more than its price. Self filters bid
+     * in ascending order from a FIFO queue, which keeps the outcome deterministic.
+     */
+    static std::vector<FilterMatch> assignAuction(const FilterMatch *first, const FilterMatch *last, float eps) {
+        //Candidates arrive grouped by self row, index the groups
+        std::vector<const FilterMatch *> bidderBegin;
+        std::vector<const FilterMatch *> bidderEnd;
+        uint32_t otherBound = 0;
+        for (const FilterMatch *c = first; c != last; c++) {
+            if (c == first || c->selfRow != (c - 1)->selfRow) {
+                bidderBegin.push_back(c);
+                bidderEnd.push_back(c);
+            }
+            bidderEnd.back() = c + 1;
+            otherBound = std::max(otherBound, c->otherRow + 1);
+        }
+
+        const uint32_t Unowned = 0xffffffff;
+        std::vector<double> price(otherBound, 0);
+        std::vector<uint32_t> owner(otherBound, Unowned);
+        std::vector<const FilterMatch *> won(bidderBegin.size(), nullptr);
+        std::deque<uint32_t> queue;
+        for (uint32_t b = 0; b < bidderBegin.size(); b++) {
+            queue.push_back(b);
+        }
+
+        while (!queue.empty()) {
+            uint32_t bidder = queue.front();
+            queue.pop_front();
+            //Best and second best net value, staying unlinked is worth 0
+            const FilterMatch *bestEdge = nullptr;
+            double bestValue = 0;
+            double secondValue = 0;
+            for (const FilterMatch *c = bidderBegin[bidder]; c != bidderEnd[bidder]; c++) {
+                double value = c->score - price[c->otherRow];
+                if (value > bestValue) {
+                    secondValue = bestValue;
+                    bestValue = value;
+                    bestEdge = c;
+                } else if (value > secondValue) {
+                    secondValue = value;
+                }
+            }
+            if (bestEdge == nullptr) {
+                continue;
+            }
+            price[bestEdge->otherRow] += bestValue - secondValue + eps;
+            uint32_t previous = owner[bestEdge->otherRow];
+            owner[bestEdge->otherRow] = bidder;
+            won[bidder] = bestEdge;
+            if (previous != Unowned) {
+                won[previous] = nullptr;
+                queue.push_back(previous);
+            }
+        }
+
+        std::vector<FilterMatch> links;
+        for (const FilterMatch *edge: won) {
+            if (edge != nullptr) {
+                links.push_back(*edge);
+            }
+        }
+        return links;
+    }
+
+    float similarityThreshold;
+    unsigned threads;
+    std::size_t tileRows;
+    uint16_t topK;
+    uint64_t lastComparisons;
+    double lastSeconds;
+};
+
+#endif //ENTITYRESOLUTION_FILTERCOMPARATOR_H
@@ -0,0 +1,227 @@
+//
+// Created by root on 10/16/26.
+//
+
+#ifndef ENTITYRESOLUTION_FILTERENCODER_H
+#define ENTITYRESOLUTION_FILTERENCODER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "bh.h"
+#include "BitMatrix.h"
+#include "EntityGraph.h"
+#include "Parallel.h"
+#include "StructuralEncoder.h"
+
+/**
+ * Attribute and structural filters of a contiguous run of entities, row i of both matrices belongs to ids[i]
+ */
+struct EncodedChunk {
+    std::size_t sequence = 0;
+    std::vector<int64_t> ids;
+    BitMatrix attrFilters;
+    BitMatrix structFilters;
+};
+
+/**
+ * Encodes entities into attribute and structural Bloom filters on a pool of worker threads.
+ * Entities are split into chunks, each worker encodes both filters of a chunk in one pass and hands it
+ * to a bounded queue; the calling thread drains the queue and passes chunks to a sink in entity order.
+ * A worker only claims a chunk within a fixed window past the next one the sink expects, so at most
+ * 2 * workers chunks are alive at any time, whatever the number of entities or how unevenly they encode.
+ */
+class FilterEncoder {
+public:
+    /**
+     * Encoder with 1-hop structural filters, neighbours inserted with numHashes hash functions
+     */
+    FilterEncoder(uint64_t filterSize, uint8_t numHashes, std::size_t chunkSize = 4096, unsigned threads = 0)
+            : FilterEncoder(filterSize, numHashes, StructuralEncoder(filterSize, {numHashes}), chunkSize, threads) {}
+
+    /**
+     * Encoder with the given structural neighbourhood (hops, weights, degree cap)
+     */
+    FilterEncoder(uint64_t filterSize, uint8_t numHashes, StructuralEncoder structure, std::size_t chunkSize = 4096,
+                  unsigned threads = 0)
+            : filterSize(filterSize),
+              numHashes(numHashes),
+              chunkSize(chunkSize == 0 ? 1 : chunkSize),
+              threads(threads == 0 ? hardwareThreads() : threads),
+              structure(std::move(structure)) {}
+
+    /**
+     * Encode all entities
+     * @param entities Attributes of every entity
+     * @param graph Neighbours of every entity row
+     * @param sink Called as sink(const EncodedChunk &) on the calling thread, in entity row (increasing ID) order
+     */
+    template <typename Sink>
+    void encode(const EntityTable &entities, const CsrGraph &graph, Sink &&sink) {
+        std::size_t chunks = (entities.size() + chunkSize - 1) / chunkSize;
+        unsigned workers = threads < chunks ? threads : (unsigned) chunks;
+        if (workers == 0) {
+            return;
+        }
+
+        //Claim window: chunk c may only be claimed once c < expected + window, which bounds the queue and the
+        //reorder buffer together even when one slow chunk holds back the sink
+        std::size_t window = 2 * workers;
+        BoundedQueue<EncodedChunk> queue(window);
+        std::mutex claimMutex;
+        std::condition_variable claimable;
+        std::size_t nextChunk = 0;
+        std::size_t expected = 0;
+        std::atomic<unsigned> running(workers);
+
+        auto claim = [&]() {
+            std::unique_lock<std::mutex> lock(claimMutex);
+            claimable.wait(lock, [&]() { return nextChunk >= chunks || nextChunk < expected + window; });
+            return nextChunk < chunks ? nextChunk++ : chunks;
+        };
+
+        std::vector<std::thread> pool;
+        for (unsigned w = 0; w < workers; w++) {
+            pool.emplace_back([&]() {
+                BloomFilter attrFilter(filterSize, numHashes);
+                BloomFilter structFilter(filterSize, numHashes);
+                StructuralEncoder::Scratch scratch;
+                for (std::size_t chunk = claim(); chunk < chunks; chunk = claim()) {
+                    std::size_t begin = chunk * chunkSize;
+                    std::size_t end = begin + chunkSize < entities.size() ? begin + chunkSize : entities.size();
+                    queue.push(encodeChunk(chunk, entities, graph, begin, end, attrFilter, structFilter,
+                                           scratch));
+                }
+                if (--running == 0) {
+                    queue.close();
+                }
+            });
+        }
+
+        //Every chunk in the reorder buffer lies in [expected, expected + window), so it never holds more than window
+        std::map<std::size_t, EncodedChunk> pending;
+        std::size_t emitted = 0;
+        EncodedChunk chunk;
+        while (queue.pop(chunk)) {
+            pending.emplace(chunk.sequence, std::move(chunk));
+            if (pending.begin()->first != emitted) {
+                continue;
+            }
+            while (!pending.empty() && pending.begin()->first == emitted) {
+                sink(static_cast<const EncodedChunk &>(pending.begin()->second));
+                pending.erase(pending.begin());
+                emitted++;
+            }
+            {
+                std::lock_guard<std::mutex> lock(claimMutex);
+                expected = emitted;
+            }
+            claimable.notify_all();
+        }
+
+        for (auto &thread: pool) {
+            thread.join();
+        }
+    }
+
+    /**
+     * Encode selected entities only, in parallel
+     * @param rows Entity rows to encode
+     * @return Filters of rows[k] in row k, sequence 0
+     */
+    EncodedChunk encodeRows(const std::vector<uint32_t> &rows, const EntityTable &entities,
+                            const CsrGraph &graph) const {
+        EncodedChunk chunk;
+        chunk.ids.resize(rows.size());
+        chunk.attrFilters = BitMatrix(rows.size(), filterSize);
+        chunk.structFilters = BitMatrix(rows.size(), filterSize);
+        parallelFor(0, rows.size(), 256, [&](std::size_t begin, std::size_t end) {
+            BloomFilter attrFilter(filterSize, numHashes);
+            BloomFilter structFilter(filterSize, numHashes);
+            //One visited array per thread rather than per chunk
+            static thread_local StructuralEncoder::Scratch scratch;
+            for (std::size_t k = begin; k < end; k++) {
+                chunk.ids[k] = entities.id(rows[k]);
+                encodeRow(rows[k], entities, graph, attrFilter, structFilter, scratch, chunk.attrFilters.row(k),
+                          chunk.structFilters.row(k));
+            }
+        }, threads);
+        return chunk;
+    }
+
+    /**
+     * Encode all entities straight into preallocated matrices, in parallel
+     * @param attrFilters Receives the attribute filter of entity row i in row i, entities.size() rows
+     * @param structFilters Receives the structural filter of entity row i in row i, entities.size() rows
+     */
+    void encodeInto(const EntityTable &entities, const CsrGraph &graph, BitMatrix &attrFilters,
+                    BitMatrix &structFilters) const {
+        parallelFor(0, entities.size(), 256, [&](std::size_t begin, std::size_t end) {
+            BloomFilter attrFilter(filterSize, numHashes);
+            BloomFilter structFilter(filterSize, numHashes);
+            static thread_local StructuralEncoder::Scratch scratch;
+            for (std::size_t i = begin; i < end; i++) {
+                encodeRow(i, entities, graph, attrFilter, structFilter, scratch, attrFilters.row(i),
+                          structFilters.row(i));
+            }
+        }, threads);
+    }
+
+    inline uint64_t getFilterSize() const { return filterSize; }
+
+    inline const StructuralEncoder &getStructure() const { return structure; }
+
+private:
+    EncodedChunk encodeChunk(std::size_t sequence, const EntityTable &entities, const CsrGraph &graph,
+                             std::size_t begin, std::size_t end,
+                             BloomFilter &attrFilter, BloomFilter &structFilter,
+                             StructuralEncoder::Scratch &scratch) const {
+        EncodedChunk chunk;
+        chunk.sequence = sequence;
+        chunk.ids.reserve(end - begin);
+        chunk.attrFilters = BitMatrix(end - begin, filterSize);
+        chunk.structFilters = BitMatrix(end - begin, filterSize);
+
+        for (std::size_t i = begin; i < end; i++) {
+            chunk.ids.push_back(entities.id(i));
+            encodeRow(i, entities, graph, attrFilter, structFilter, scratch, chunk.attrFilters.row(i - begin),
+                      chunk.structFilters.row(i - begin));
+        }
+
+        return chunk;
+    }
+
+    void encodeRow(std::size_t i, const EntityTable &entities, const CsrGraph &graph,
+                   BloomFilter &attrFilter, BloomFilter &structFilter, StructuralEncoder::Scratch &scratch,
+                   uint64_t *attrRow, uint64_t *structRow) const {
+        //Attribute filter from all attributes of the entity
+        attrFilter.reset();
+        for (std::size_t k = 0; k < entities.attributeCount(i); k++) {
+            attrFilter.insert(entities.attribute(i, k));
+        }
+        copyWords(attrFilter, attrRow);
+
+        //Structural filter from the first attribute of each (sampled) vertex in the neighbourhood
+        structFilter.reset();
+        structure.encode(i, entities, graph, structFilter, scratch);
+        copyWords(structFilter, structRow);
+    }
+
+    static inline void copyWords(const BloomFilter &filter, uint64_t *row) {
+        const uint64_t *words = filter.words();
+        for (std::size_t w = 0; w < filter.numWords(); w++) {
+            row[w] = words[w];
+        }
+    }
+
+    uint64_t filterSize;
+    uint8_t numHashes;
+    std::size_t chunkSize;
+    unsigned threads;
+    StructuralEncoder structure;
+};
+
+#endif //ENTITYRESOLUTION_FILTERENCODER_H
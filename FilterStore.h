@@ -0,0 +1,313 @@
+//
+// Created by root on 10/16/26.
+//
+
+#ifndef ENTITYRESOLUTION_FILTERSTORE_H
+#define ENTITYRESOLUTION_FILTERSTORE_H
+
+#include <stdint.h>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "BitMatrix.h"
+#include "MappedFile.h"
+
+/*
+ * Binary filter file, little-endian:
+ *
+ *   FilterFileHeader (64 bytes)
+ *   count rows of packed filters, wordsPerFilter uint64_t words each (bit b in word b / 64, position b % 64)
+ *   count int64_t entity IDs, ID i belongs to row i
+ *
+ * Rows start on a 64 byte boundary so a mapped file can be handed to the popcount kernels as is.
+ */
+struct FilterFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t filterBits;
+    uint64_t wordsPerFilter;
+    uint64_t count;
+    uint64_t rowsOffset;
+    uint64_t idsOffset;
+    //Generation of the persisted state the file belongs to, 0 for files outside one
+    uint64_t generation;
+};
+
+static_assert(sizeof(FilterFileHeader) == 64, "filter file header must stay 64 bytes");
+
+static const char FilterFileMagic[8] = {'E', 'R', 'B', 'L', 'O', 'O', 'M', '\0'};
+static const uint32_t FilterFileVersion = 1;
+
+/**
+ * Streams filters into a binary filter file. Rows go straight to disk, IDs are held until close()
+ * since they follow the rows.
+ */
+class FilterStoreWriter {
+public:
+    FilterStoreWriter() : filterBits(0), words(0), generation(0) {}
+
+    ~FilterStoreWriter() {
+        close();
+    }
+
+    /**
+     * Create (or truncate) a filter file
+     * @param path Output file
+     * @param bits Filter length in bits
+     * @param stateGeneration Generation stamped into the header
+     * @return false if the file could not be created
+     */
+    bool open(const std::string &path, uint64_t bits, uint64_t stateGeneration = 0) {
+        close();
+        filterBits = bits;
+        words = (bits + 63) / 64;
+        generation = stateGeneration;
+        ids.clear();
+        filePath = path;
+        stream.open(path, std::ios::binary | std::ios::out | std::ios::trunc);
+        if (!stream) {
+            return false;
+        }
+        //Placeholder header, rewritten with the final count on close
+        FilterFileHeader header = makeHeader(0);
+        stream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        return (bool) stream;
+    }
+
+    inline void append(int64_t id, const uint64_t *row) {
+        ids.push_back(id);
+        stream.write(reinterpret_cast<const char *>(row), words * sizeof(uint64_t));
+    }
+
+    /**
+     * Append every row of a packed matrix
+     * @param rowIds Entity ID of each row
+     * @param filters Packed filters, same length as the file
+     */
+    template <typename I>
+    void append(const std::vector<I> &rowIds, const BitMatrixView &filters) {
+        append(rowIds.data(), filters);
+    }
+
+    template <typename I>
+    void append(const I *rowIds, const BitMatrixView &filters) {
+        if (filters.nRows() == 0) {
+            return;
+        }
+        for (std::size_t i = 0; i < filters.nRows(); i++) {
+            ids.push_back(rowIds[i]);
+        }
+        stream.write(reinterpret_cast<const char *>(filters.row(0)), filters.nRows() * words * sizeof(uint64_t));
+    }
+
+    /**
+     * Write the ID column and the final header
+     * @return false if any write failed
+     */
+    bool close() {
+        if (!stream.is_open()) {
+            return true;
+        }
+        stream.write(reinterpret_cast<const char *>(ids.data()), ids.size() * sizeof(int64_t));
+        FilterFileHeader header = makeHeader(ids.size());
+        stream.seekp(0);
+        stream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        bool ok = (bool) stream;
+        stream.close();
+        ids.clear();
+        return ok;
+    }
+
+    /**
+     * Abandon the file being written: no header is finalised and the partial file is deleted, so a failed
+     * conversion never leaves a file that loads
+     */
+    void discard() {
+        if (stream.is_open()) {
+            stream.close();
+            std::remove(filePath.c_str());
+        }
+        ids.clear();
+    }
+
+private:
+    FilterFileHeader makeHeader(uint64_t count) const {
+        FilterFileHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, FilterFileMagic, sizeof(header.magic));
+        header.version = FilterFileVersion;
+        header.headerSize = sizeof(FilterFileHeader);
+        header.filterBits = filterBits;
+        header.wordsPerFilter = words;
+        header.count = count;
+        header.rowsOffset = sizeof(FilterFileHeader);
+        header.idsOffset = sizeof(FilterFileHeader) + count * words * sizeof(uint64_t);
+        header.generation = generation;
+        return header;
+    }
+
+    uint64_t filterBits;
+    uint64_t words;
+    uint64_t generation;
+    std::string filePath;
+    std::vector<int64_t> ids;
+    std::ofstream stream;
+};
+
+/**
+ * Memory mapped binary filter file. Rows and IDs are read in place, nothing is parsed or copied.
+ */
+class FilterStore {
+public:
+    FilterStore() : header(nullptr) {}
+
+    /**
+     * Map and validate a filter file
+     * @param path File written by FilterStoreWriter
+     * @return false if the file is missing, truncated or not a filter file of a known version
+     */
+    bool load(const std::string &path) {
+        header = nullptr;
+        if (!file.open(path) || file.size() < sizeof(FilterFileHeader)) {
+            return false;
+        }
+        const FilterFileHeader *candidate = reinterpret_cast<const FilterFileHeader *>(file.data());
+        if (std::memcmp(candidate->magic, FilterFileMagic, sizeof(FilterFileMagic)) != 0 ||
+            candidate->version != FilterFileVersion ||
+            candidate->wordsPerFilter != (candidate->filterBits + 63) / 64 ||
+            !sectionsFit(*candidate, file.size())) {
+            file.close();
+            return false;
+        }
+        header = candidate;
+        return true;
+    }
+
+    inline std::size_t size() const { return header == nullptr ? 0 : header->count; }
+
+    inline std::size_t nBits() const { return header == nullptr ? 0 : header->filterBits; }
+
+    inline std::size_t nWords() const { return header == nullptr ? 0 : header->wordsPerFilter; }
+
+    inline uint64_t generation() const { return header == nullptr ? 0 : header->generation; }
+
+    inline const uint64_t *row(std::size_t i) const {
+        return rows() + i * header->wordsPerFilter;
+    }
+
+    inline int64_t id(std::size_t i) const {
+        return ids()[i];
+    }
+
+    inline const int64_t *ids() const {
+        return reinterpret_cast<const int64_t *>(file.data() + header->idsOffset);
+    }
+
+    inline BitMatrixView view() const {
+        return header == nullptr ? BitMatrixView() : BitMatrixView(rows(), size(), nBits());
+    }
+
+private:
+    /**
+     * Rows and IDs lie inside the file, aligned and in order. Counts are bounded by division first, so a
+     * corrupt header cannot wrap the byte sizes around and pass.
+     */
+    static bool sectionsFit(const FilterFileHeader &header, std::size_t size) {
+        uint64_t rowBytes = header.wordsPerFilter * sizeof(uint64_t);
+        if (header.rowsOffset % 64 != 0 || header.rowsOffset < sizeof(FilterFileHeader) ||
+            header.rowsOffset > size || (rowBytes != 0 && header.count > (size - header.rowsOffset) / rowBytes)) {
+            return false;
+        }
+        uint64_t rowsEnd = header.rowsOffset + header.count * rowBytes;
+        return header.idsOffset % sizeof(int64_t) == 0 && header.idsOffset >= rowsEnd && header.idsOffset <= size &&
+               header.count <= (size - header.idsOffset) / sizeof(int64_t);
+    }
+
+    inline const uint64_t *rows() const {
+        return reinterpret_cast<const uint64_t *>(file.data() + header->rowsOffset);
+    }
+
+    MappedFile file;
+    const FilterFileHeader *header;
+};
+
+/**
+ * Convert a CSV filter file (rows of "id,b,b,...,b" with the highest bit first, as attrfilters.txt and
+ * structfilters.txt were written) into the binary filter format
+ * @param csvPath Input CSV file
+ * @param binaryPath Output binary filter file
+ * @return Number of filters converted, or -1 if a file could not be opened or a row has the wrong length, in which
+ * case no binary file is left behind
+ */
+inline long convertCsvFilters(const std::string &csvPath, const std::string &binaryPath) {
+    std::ifstream in(csvPath);
+    if (!in) {
+        return -1;
+    }
+
+    FilterStoreWriter writer;
+    std::vector<uint64_t> row;
+    std::size_t bits = 0;
+    long count = 0;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        std::size_t comma = line.find(',');
+        if (comma == std::string::npos) {
+            writer.discard();
+            return -1;
+        }
+
+        //Filter length is fixed by the first row
+        std::size_t rowBits = 0;
+        for (std::size_t pos = comma; pos < line.size(); pos++) {
+            rowBits += line[pos] == ',';
+        }
+        if (count == 0) {
+            bits = rowBits;
+            row.assign((bits + 63) / 64, 0);
+            if (!writer.open(binaryPath, bits)) {
+                return -1;
+            }
+        } else if (rowBits != bits) {
+            writer.discard();
+            return -1;
+        }
+
+        std::fill(row.begin(), row.end(), 0);
+        std::size_t column = 0;
+        for (std::size_t pos = comma + 1; pos < line.size(); pos++) {
+            if (line[pos] == ',') {
+                column++;
+            } else if (line[pos] == '1') {
+                std::size_t bit = bits - 1 - column;
+                row[bit >> 6] |= uint64_t(1) << (bit & 63);
+            }
+        }
+        int64_t id;
+        auto parsed = std::from_chars(line.data(), line.data() + comma, id);
+        if (parsed.ec != std::errc() || parsed.ptr != line.data() + comma) {
+            writer.discard();
+            return -1;
+        }
+        writer.append(id, row.data());
+        count++;
+    }
+
+    if (count == 0 && !writer.open(binaryPath, 0)) {
+        return -1;
+    }
+    if (!writer.close()) {
+        std::remove(binaryPath.c_str());
+        return -1;
+    }
+    return count;
+}
+
+#endif //ENTITYRESOLUTION_FILTERSTORE_H
@@ -0,0 +1,664 @@
+//
+// Created by root on 10/16/26.
+//
+
+#ifndef ENTITYRESOLUTION_INCREMENTALRESOLVER_H
+#define ENTITYRESOLUTION_INCREMENTALRESOLVER_H
+
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <armadillo>
+#include "BinaryKmeans.h"
+#include "BitMatrix.h"
+#include "EntityGraph.h"
+#include "FilterEncoder.h"
+#include "FilterStore.h"
+#include "LSHIndex.h"
+#include "MappedFile.h"
+#include "MinHash.hpp"
+#include "Parallel.h"
+
+/*
+ * Persisted state of one party, a manifest naming the current generation g and four files of that generation,
+ * all sharing a path prefix:
+ *
+ *   <prefix>state                    StateManifest
+ *   <prefix>attrfilters.<g>.bin      filter files (FilterStore.h), rows in entity ID order
+ *   <prefix>structfilters.<g>.bin
+ *   <prefix>means.<g>.bin            filter file of the cluster centroids, IDs 0 .. clusters - 1
+ *   <prefix>clusters.<g>.bin         ClusterFileHeader, then
+ *       count uint16_t cluster assignments, row i as in the filter files
+ *       clusters uint32_t cluster sizes
+ *       clusters * filterBits uint32_t counts of every attribute filter bit over the members of each cluster
+ *       clusters * signatureLength int16_t CRVs, cluster c starting at c * signatureLength
+ *
+ * LSH bucket keys are a pure function of the CRVs, so the buckets are persisted through them. A save writes the
+ * files of generation g + 1 beside those of g, then renames a new manifest over the old one, which is the only
+ * step that switches state; the files of g are deleted after it. An interrupted run therefore leaves generation g
+ * intact and current. Every file header carries its generation as well and a load rejects files that do not
+ * match the manifest.
+ */
+struct StateManifest {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t generation;
+    uint64_t reserved;
+};
+
+static_assert(sizeof(StateManifest) == 32, "state manifest must stay 32 bytes");
+
+static const char StateManifestMagic[8] = {'E', 'R', 'S', 'T', 'A', 'T', 'E', '\0'};
+static const uint32_t StateManifestVersion = 1;
+
+struct ClusterFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t count;
+    uint64_t clusters;
+    uint64_t filterBits;
+    uint64_t signatureLength;
+    uint64_t generation;
+    uint64_t reserved;
+};
+
+static_assert(sizeof(ClusterFileHeader) == 64, "cluster file header must stay 64 bytes");
+
+static const char ClusterFileMagic[8] = {'E', 'R', 'C', 'L', 'U', 'S', 'T', '\0'};
+static const uint32_t ClusterFileVersion = 1;
+
+/**
+ * Changes since the persisted state: entities added, removed or with modified attributes by ID, and edges added
+ * or removed by their endpoint IDs. Removing an entity removes its edges, which have to be listed as well.
+ */
+struct GraphDelta {
+    std::vector<int64_t> entities;
+    std::vector<std::pair<int64_t, int64_t>> edges;
+
+    /**
+     * Read a delta file: one change per line, "id" for an entity or "from to" for an edge, fields separated by
+     * spaces. Blank lines and lines not starting with an integer are skipped, as in the entity and edge files.
+     * @return false if the file could not be mapped
+     */
+    bool load(const std::string &path) {
+        MappedFile file;
+        if (!file.open(path)) {
+            return false;
+        }
+        entities.clear();
+        edges.clear();
+        const char *pos = file.data();
+        const char *end = file.data() + file.size();
+        while (pos < end) {
+            const char *lineEnd = std::find(pos, end, '\n');
+            int64_t vertex[2];
+            int fields = 0;
+            for (; fields < 2; fields++) {
+                while (pos < lineEnd && isFieldSeparator(*pos)) {
+                    pos++;
+                }
+                auto result = std::from_chars(pos, lineEnd, vertex[fields]);
+                if (result.ec != std::errc()) {
+                    break;
+                }
+                pos = result.ptr;
+            }
+            if (fields == 1) {
+                entities.push_back(vertex[0]);
+            } else if (fields == 2) {
+                edges.push_back({vertex[0], vertex[1]});
+            }
+            pos = lineEnd + 1;
+        }
+        return true;
+    }
+};
+
+/**
+ * What the last build or update touched
+ */
+struct UpdateSummary {
+    std::size_t reencoded = 0;
+    std::size_t reassigned = 0;
+    std::size_t removed = 0;
+    std::vector<uint16_t> changedClusters;
+};
+
+/**
+ * Encode, cluster, CRV and LSH stages of one party for a graph that changes a little between runs.
+ *
+ * The structural filter of a vertex depends on the attributes of the vertices up to hops() away and on the edges
+ * leaving vertices less than hops() away. After a delta only the vertices reaching a changed entity within hops()
+ * steps, or the source of a changed edge within hops() - 1 steps, are encoded again; they are found by a
+ * breadth-first search over the reversed graph and every other filter is copied from the persisted state.
+ * Re-encoded entities are assigned to the nearest persisted centroid, or all entities to centroids refined by a
+ * warm-start fit. Per cluster bit counts are updated by the difference, so only clusters that gained, lost or
+ * changed a member get a new CRV and the cost of an update follows the size of the delta. The LSH index keeps
+ * a copy of the CRVs it was built from and rebuckets only the clusters whose CRV differs from it; a resolver that
+ * starts on a persisted state has no index yet and buckets every cluster once.
+ */
+class IncrementalResolver {
+public:
+    /**
+     * @param encoder Filter encoder, the same for every run on one state
+     * @param clusters Number of clusters
+     * @param minHash CRV generator, the same for every run on one state
+     * @param densityRank Rank of the density threshold of the CRVs
+     * @param bands LSH bands
+     * @param rows LSH rows per band
+     * @param threads Number of threads, 0 for hardwareThreads()
+     */
+    IncrementalResolver(FilterEncoder encoder, uint16_t clusters, MinHash minHash, uint8_t densityRank,
+                        uint16_t bands, uint16_t rows, unsigned threads = 0)
+            : encoder(std::move(encoder)),
+              clusters(clusters),
+              minHash(std::move(minHash)),
+              densityRank(densityRank),
+              threads(threads == 0 ? hardwareThreads() : threads),
+              generation(0),
+              index(bands, rows) {}
+
+    /**
+     * Run every stage on the whole graph and persist the state
+     * @param statePrefix Path prefix of the state files
+     * @param iterations Clustering iterations
+     * @param seed Seed of the centroid selection
+     * @return false if clustering failed, the CRVs could not be made or the state could not be written
+     */
+    bool build(const EntityTable &entities, const CsrGraph &graph, const std::string &statePrefix,
+               uint16_t iterations = 10, uint64_t seed = 0) {
+        //Continue the numbering of a state already there, so its files are not overwritten before the switch
+        generation = loadManifest(statePrefix);
+        std::vector<uint32_t> rows(entities.size());
+        for (std::size_t r = 0; r < rows.size(); r++) {
+            rows[r] = r;
+        }
+        EncodedChunk encoded = encoder.encodeRows(rows, entities, graph);
+
+        BinaryKmeans model(clusters, threads);
+        if (!model.fit(encoded.attrFilters.view(), iterations, seed)) {
+            return false;
+        }
+        assignment = model.apply(encoded.attrFilters.view());
+        means = model.getMeans();
+
+        std::size_t bits = encoder.getFilterSize();
+        sizes.assign(clusters, 0);
+        counts.assign((std::size_t) clusters * bits, 0);
+        for (std::size_t r = 0; r < rows.size(); r++) {
+            addMember(assignment[r], encoded.attrFilters.row(r), 1);
+        }
+        crvs.set_size(minHash.getSize(), clusters);
+        std::vector<uint16_t> all(clusters);
+        for (uint16_t c = 0; c < clusters; c++) {
+            all[c] = c;
+        }
+        if (!updateCrvs(all)) {
+            return false;
+        }
+
+        summary = UpdateSummary();
+        summary.reencoded = rows.size();
+        summary.reassigned = rows.size();
+        summary.changedClusters = all;
+        return save(statePrefix, entities.allIds(), encoded.attrFilters.view(), encoded.structFilters.view());
+    }
+
+    /**
+     * Bring a persisted state up to date with a changed graph and persist it again
+     * @param entities Entities after the change
+     * @param graph Graph after the change
+     * @param delta Entities and edges changed since the state was written
+     * @param statePrefix Path prefix of the state files
+     * @param refitIterations 0 to keep the persisted centroids, otherwise the iterations of a warm-start fit
+     * over all entities
+     * @return false if the state is missing or does not match this resolver, the CRVs could not be made or the
+     * state could not be written
+     */
+    bool update(const EntityTable &entities, const CsrGraph &graph, const GraphDelta &delta,
+                const std::string &statePrefix, uint16_t refitIterations = 0) {
+        std::size_t bits = encoder.getFilterSize();
+        std::size_t words = (bits + 63) / 64;
+        generation = loadManifest(statePrefix);
+        FilterStore oldAttr;
+        FilterStore oldStruct;
+        FilterStore oldMeans;
+        MappedFile clusterFile;
+        if (generation == 0 || !oldAttr.load(statePath(statePrefix, "attrfilters", generation)) ||
+            !oldStruct.load(statePath(statePrefix, "structfilters", generation)) ||
+            !oldMeans.load(statePath(statePrefix, "means", generation)) ||
+            !clusterFile.open(statePath(statePrefix, "clusters", generation)) ||
+            !loadClusters(clusterFile, oldAttr.size()) || oldAttr.generation() != generation ||
+            oldStruct.generation() != generation || oldMeans.generation() != generation ||
+            oldAttr.nBits() != bits || oldStruct.size() != oldAttr.size() || oldStruct.nBits() != bits ||
+            oldMeans.size() != clusters || oldMeans.nBits() != bits) {
+            std::cout << "no matching state at " << statePrefix << std::endl;
+            return false;
+        }
+        std::vector<uint16_t> oldAssignment = assignment;
+        summary = UpdateSummary();
+
+        //Old row of every entity by a merge join on the sorted IDs, -1 for new entities
+        std::size_t n = entities.size();
+        std::vector<long> oldRow(n, -1);
+        std::vector<uint8_t> kept(oldAttr.size(), 0);
+        const int64_t *oldIds = oldAttr.ids();
+        for (std::size_t r = 0, o = 0; r < n; r++) {
+            while (o < oldAttr.size() && oldIds[o] < entities.id(r)) {
+                o++;
+            }
+            if (o < oldAttr.size() && oldIds[o] == entities.id(r)) {
+                oldRow[r] = o;
+                kept[o] = 1;
+            }
+        }
+
+        //Encode what the delta can reach, and entities the state has not seen
+        std::vector<uint8_t> affected = affectedRows(entities, graph, delta);
+        std::vector<uint32_t> changedRows;
+        for (std::size_t r = 0; r < n; r++) {
+            if (affected[r] || oldRow[r] < 0) {
+                changedRows.push_back(r);
+            }
+        }
+        EncodedChunk encoded = encoder.encodeRows(changedRows, entities, graph);
+        summary.reencoded = changedRows.size();
+
+        //New filters, copied from the state unless encoded again
+        BitMatrix attrFilters(n, bits);
+        BitMatrix structFilters(n, bits);
+        parallelFor(0, n, 1 << 14, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t r = begin; r < end; r++) {
+                if (oldRow[r] >= 0) {
+                    std::copy(oldAttr.row(oldRow[r]), oldAttr.row(oldRow[r]) + words, attrFilters.row(r));
+                    std::copy(oldStruct.row(oldRow[r]), oldStruct.row(oldRow[r]) + words, structFilters.row(r));
+                }
+            }
+        }, threads);
+        parallelFor(0, changedRows.size(), 1 << 12, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t k = begin; k < end; k++) {
+                std::copy(encoded.attrFilters.row(k), encoded.attrFilters.row(k) + words,
+                          attrFilters.row(changedRows[k]));
+                std::copy(encoded.structFilters.row(k), encoded.structFilters.row(k) + words,
+                          structFilters.row(changedRows[k]));
+            }
+        }, threads);
+
+        //Assign changed entities to the persisted centroids, or everything to refined ones
+        assignment.assign(n, 0);
+        for (std::size_t r = 0; r < n; r++) {
+            if (oldRow[r] >= 0) {
+                assignment[r] = oldAssignment[oldRow[r]];
+            }
+        }
+        BinaryKmeans model(clusters, threads);
+        if (refitIterations > 0) {
+            if (!model.fit(attrFilters.view(), oldMeans.view(), refitIterations)) {
+                return false;
+            }
+            assignment = model.apply(attrFilters.view());
+            means = model.getMeans();
+            summary.reassigned = n;
+        } else {
+            means = BitMatrix(clusters, bits);
+            std::copy(oldMeans.view().row(0), oldMeans.view().row(0) + (std::size_t) clusters * words, means.row(0));
+            if (!changedRows.empty()) {
+                //No iterations, the fit only installs the persisted centroids
+                if (!model.fit(encoded.attrFilters.view(), oldMeans.view(), 0)) {
+                    return false;
+                }
+                std::vector<uint16_t> nearest = model.apply(encoded.attrFilters.view());
+                for (std::size_t k = 0; k < changedRows.size(); k++) {
+                    assignment[changedRows[k]] = nearest[k];
+                }
+            }
+            summary.reassigned = changedRows.size();
+        }
+
+        //Move bit counts of members that left, joined or changed, marking their clusters
+        std::vector<uint8_t> dirty(clusters, 0);
+        for (std::size_t o = 0; o < oldAttr.size(); o++) {
+            if (!kept[o]) {
+                addMember(oldAssignment[o], oldAttr.row(o), -1);
+                dirty[oldAssignment[o]] = 1;
+                summary.removed++;
+            }
+        }
+        auto moveMember = [&](std::size_t r) {
+            const uint64_t *row = attrFilters.row(r);
+            if (oldRow[r] < 0) {
+                addMember(assignment[r], row, 1);
+                dirty[assignment[r]] = 1;
+                return;
+            }
+            uint16_t before = oldAssignment[oldRow[r]];
+            const uint64_t *oldFilter = oldAttr.row(oldRow[r]);
+            if (before != assignment[r] || !std::equal(row, row + words, oldFilter)) {
+                addMember(before, oldFilter, -1);
+                addMember(assignment[r], row, 1);
+                dirty[before] = 1;
+                dirty[assignment[r]] = 1;
+            }
+        };
+        if (refitIterations > 0) {
+            for (std::size_t r = 0; r < n; r++) {
+                moveMember(r);
+            }
+        } else {
+            for (uint32_t r: changedRows) {
+                moveMember(r);
+            }
+        }
+
+        for (uint16_t c = 0; c < clusters; c++) {
+            if (dirty[c]) {
+                summary.changedClusters.push_back(c);
+            }
+        }
+        if (!updateCrvs(summary.changedClusters)) {
+            return false;
+        }
+        return save(statePrefix, entities.allIds(), attrFilters.view(), structFilters.view());
+    }
+
+    /**
+     * Cluster of every entity row after the last build or update
+     */
+    inline const std::vector<uint16_t> &getAssignment() const { return assignment; }
+
+    inline const BitMatrix &getMeans() const { return means; }
+
+    /**
+     * CRV of cluster c in column c
+     */
+    inline const arma::Mat<short> &getCRVs() const { return crvs; }
+
+    /**
+     * LSH buckets of the CRVs, cluster c as item c
+     */
+    inline const LSHIndex &getIndex() const { return index; }
+
+    inline const UpdateSummary &lastUpdate() const { return summary; }
+
+    /**
+     * Generation of the state the last build or update wrote or read, 0 if none
+     */
+    inline uint64_t getGeneration() const { return generation; }
+
+    /**
+     * Path of one state file, name being attrfilters, structfilters, means or clusters
+     */
+    static std::string statePath(const std::string &prefix, const std::string &name, uint64_t generation) {
+        return prefix + name + "." + std::to_string(generation) + ".bin";
+    }
+
+    /**
+     * Generation named by the manifest at a prefix
+     * @return 0 if there is no valid manifest
+     */
+    static uint64_t loadManifest(const std::string &prefix) {
+        StateManifest manifest;
+        std::ifstream stream(prefix + "state", std::ios::binary | std::ios::in);
+        if (!stream.read(reinterpret_cast<char *>(&manifest), sizeof(manifest)) ||
+            std::memcmp(manifest.magic, StateManifestMagic, sizeof(StateManifestMagic)) != 0 ||
+            manifest.version != StateManifestVersion) {
+            return 0;
+        }
+        return manifest.generation;
+    }
+
+private:
+    /**
+     * Rows whose filters may differ after the delta, by a search from the changed entities and edge sources
+     * over the reversed graph, each seed reaching as far back as the structural filters look ahead
+     */
+    std::vector<uint8_t> affectedRows(const EntityTable &entities, const CsrGraph &graph,
+                                      const GraphDelta &delta) const {
+        std::size_t n = entities.size();
+        int32_t hops = encoder.getStructure().hops();
+        std::vector<uint8_t> affected(n, 0);
+        std::vector<int32_t> reach(n, -1);
+        std::vector<std::vector<uint32_t>> levels(hops + 1);
+        auto mark = [&](long row, int32_t remaining) {
+            if (row >= 0 && remaining > reach[row]) {
+                reach[row] = remaining;
+                affected[row] = 1;
+                levels[remaining].push_back(row);
+            }
+        };
+        for (int64_t entity: delta.entities) {
+            mark(entities.row(entity), hops);
+        }
+        for (const auto &edge: delta.edges) {
+            if (hops > 0) {
+                mark(entities.row(edge.first), hops - 1);
+            }
+        }
+        if (hops == 0) {
+            return affected;
+        }
+
+        //Reversed edges, only needed when there is anything to search from
+        bool any = false;
+        for (int32_t level = 1; level <= hops; level++) {
+            any = any || !levels[level].empty();
+        }
+        if (!any) {
+            return affected;
+        }
+        std::vector<std::vector<std::pair<uint32_t, uint32_t>>> reversed(1);
+        reversed[0].reserve(graph.edgeCount());
+        for (std::size_t v = 0; v < graph.size(); v++) {
+            for (const uint32_t *to = graph.begin(v); to != graph.end(v); to++) {
+                reversed[0].push_back({*to, (uint32_t) v});
+            }
+        }
+        CsrGraph incoming;
+        incoming.build(n, reversed);
+
+        //Highest remaining reach first, a row raised later is simply expanded again from its higher level
+        for (int32_t level = hops; level > 0; level--) {
+            for (std::size_t k = 0; k < levels[level].size(); k++) {
+                uint32_t row = levels[level][k];
+                if (reach[row] != level) {
+                    continue;
+                }
+                for (const uint32_t *from = incoming.begin(row); from != incoming.end(row); from++) {
+                    mark(*from, level - 1);
+                }
+            }
+        }
+        return affected;
+    }
+
+    inline void addMember(uint16_t cluster, const uint64_t *filter, int32_t sign) {
+        std::size_t bits = encoder.getFilterSize();
+        uint32_t *clusterCounts = counts.data() + (std::size_t) cluster * bits;
+        sizes[cluster] += sign;
+        for (std::size_t w = 0; w < (bits + 63) / 64; w++) {
+            for (uint64_t word = filter[w]; word != 0; word &= word - 1) {
+                clusterCounts[w * 64 + __builtin_ctzll(word)] += sign;
+            }
+        }
+    }
+
+    /**
+     * New CRVs of the given clusters from their bit counts, then LSH buckets of the CRVs that differ from the
+     * indexed ones, or of all CRVs if the index was built for another shape
+     * @return false if the filter size does not match the MinHash filter length or the CRVs are shorter than
+     * bands * rows
+     */
+    bool updateCrvs(const std::vector<uint16_t> &changed) {
+        std::size_t bits = encoder.getFilterSize();
+        std::atomic<bool> ok(true);
+        parallelFor(0, changed.size(), 1, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t k = begin; k < end; k++) {
+                uint16_t c = changed[k];
+                arma::Col<float> density = minHash.getDensity(counts.data() + (std::size_t) c * bits, bits,
+                                                              sizes[c]);
+                arma::Col<short> crv = minHash.generateCRV(density, densityRank);
+                if (crv.n_elem == 0) {
+                    ok = false;
+                    return;
+                }
+                crvs.col(c) = crv;
+            }
+        }, threads);
+        if (!ok) {
+            std::cout << "filters have " << bits << " bits, the MinHash of this resolver expects another length"
+                      << std::endl;
+            return false;
+        }
+        if (indexedCrvs.n_rows != crvs.n_rows || indexedCrvs.n_cols != crvs.n_cols) {
+            index.clear();
+            if (!index.insert(crvs)) {
+                indexedCrvs.reset();
+                return false;
+            }
+        } else {
+            for (uint16_t c = 0; c < clusters; c++) {
+                if (!std::equal(crvs.colptr(c), crvs.colptr(c) + crvs.n_rows, indexedCrvs.colptr(c))) {
+                    index.remove(c, indexedCrvs.colptr(c));
+                    index.insert(c, crvs.colptr(c));
+                }
+            }
+        }
+        indexedCrvs = crvs;
+        return true;
+    }
+
+    bool loadClusters(const MappedFile &file, std::size_t count) {
+        if (file.size() < sizeof(ClusterFileHeader)) {
+            return false;
+        }
+        const ClusterFileHeader *header = reinterpret_cast<const ClusterFileHeader *>(file.data());
+        std::size_t bits = encoder.getFilterSize();
+        std::size_t length = minHash.getSize();
+        std::size_t expected = sizeof(ClusterFileHeader) + count * sizeof(uint16_t) + clusters * sizeof(uint32_t) +
+                               (std::size_t) clusters * bits * sizeof(uint32_t) +
+                               (std::size_t) clusters * length * sizeof(short);
+        if (file.size() != expected || std::memcmp(header->magic, ClusterFileMagic, sizeof(ClusterFileMagic)) != 0 ||
+            header->version != ClusterFileVersion || header->count != count || header->clusters != clusters ||
+            header->filterBits != bits || header->signatureLength != length || header->generation != generation) {
+            return false;
+        }
+        const char *pos = file.data() + sizeof(ClusterFileHeader);
+        assignment.assign(reinterpret_cast<const uint16_t *>(pos), reinterpret_cast<const uint16_t *>(pos) + count);
+        pos += count * sizeof(uint16_t);
+        sizes.assign(reinterpret_cast<const uint32_t *>(pos), reinterpret_cast<const uint32_t *>(pos) + clusters);
+        pos += clusters * sizeof(uint32_t);
+        counts.assign(reinterpret_cast<const uint32_t *>(pos),
+                      reinterpret_cast<const uint32_t *>(pos) + (std::size_t) clusters * bits);
+        pos += (std::size_t) clusters * bits * sizeof(uint32_t);
+        crvs.set_size(length, clusters);
+        std::memcpy(crvs.memptr(), pos, (std::size_t) clusters * length * sizeof(short));
+        return true;
+    }
+
+    /**
+     * Write the next generation beside the current one and switch the manifest over to it
+     */
+    bool save(const std::string &prefix, const std::vector<int64_t> &ids, const BitMatrixView &attrFilters,
+              const BitMatrixView &structFilters) {
+        std::vector<int64_t> clusterIds(clusters);
+        for (uint16_t c = 0; c < clusters; c++) {
+            clusterIds[c] = c;
+        }
+        uint64_t previous = generation;
+        uint64_t next = previous + 1;
+        bool ok = saveFilters(statePath(prefix, "attrfilters", next), ids, attrFilters, next) &&
+                  saveFilters(statePath(prefix, "structfilters", next), ids, structFilters, next) &&
+                  saveFilters(statePath(prefix, "means", next), clusterIds, means.view(), next) &&
+                  saveClusters(statePath(prefix, "clusters", next), next) &&
+                  saveManifest(prefix, next);
+        if (!ok) {
+            std::cout << "could not write state at " << prefix << std::endl;
+            return false;
+        }
+        generation = next;
+        if (previous != 0) {
+            for (const char *name: {"attrfilters", "structfilters", "means", "clusters"}) {
+                std::remove(statePath(prefix, name, previous).c_str());
+            }
+        }
+        return true;
+    }
+
+    static bool saveManifest(const std::string &prefix, uint64_t stateGeneration) {
+        StateManifest manifest;
+        std::memset(&manifest, 0, sizeof(manifest));
+        std::memcpy(manifest.magic, StateManifestMagic, sizeof(manifest.magic));
+        manifest.version = StateManifestVersion;
+        manifest.headerSize = sizeof(StateManifest);
+        manifest.generation = stateGeneration;
+
+        //The rename is the commit point of a save
+        std::string path = prefix + "state";
+        std::ofstream stream(path + ".tmp", std::ios::binary | std::ios::out | std::ios::trunc);
+        stream.write(reinterpret_cast<const char *>(&manifest), sizeof(manifest));
+        stream.close();
+        return (bool) stream && std::rename((path + ".tmp").c_str(), path.c_str()) == 0;
+    }
+
+    static bool saveFilters(const std::string &path, const std::vector<int64_t> &ids, const BitMatrixView &filters,
+                            uint64_t stateGeneration) {
+        FilterStoreWriter writer;
+        if (!writer.open(path, filters.nBits(), stateGeneration)) {
+            return false;
+        }
+        if (filters.nRows() > 0) {
+            writer.append(ids, filters);
+        }
+        return writer.close();
+    }
+
+    bool saveClusters(const std::string &path, uint64_t stateGeneration) const {
+        ClusterFileHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, ClusterFileMagic, sizeof(header.magic));
+        header.version = ClusterFileVersion;
+        header.headerSize = sizeof(ClusterFileHeader);
+        header.count = assignment.size();
+        header.clusters = clusters;
+        header.filterBits = encoder.getFilterSize();
+        header.signatureLength = minHash.getSize();
+        header.generation = stateGeneration;
+
+        std::ofstream stream(path, std::ios::binary | std::ios::out | std::ios::trunc);
+        stream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        stream.write(reinterpret_cast<const char *>(assignment.data()), assignment.size() * sizeof(uint16_t));
+        stream.write(reinterpret_cast<const char *>(sizes.data()), sizes.size() * sizeof(uint32_t));
+        stream.write(reinterpret_cast<const char *>(counts.data()), counts.size() * sizeof(uint32_t));
+        stream.write(reinterpret_cast<const char *>(crvs.memptr()), crvs.n_elem * sizeof(short));
+        stream.close();
+        return (bool) stream;
+    }
+
+    FilterEncoder encoder;
+    uint16_t clusters;
+    MinHash minHash;
+    uint8_t densityRank;
+    unsigned threads;
+    uint64_t generation;
+    std::vector<uint16_t> assignment;
+    BitMatrix means;
+    std::vector<uint32_t> sizes;
+    std::vector<uint32_t> counts;
+    arma::Mat<short> crvs;
+    //CRVs the index holds buckets of, empty before the first bucketing
+    arma::Mat<short> indexedCrvs;
+    LSHIndex index;
+    UpdateSummary summary;
+};
+
+#endif //ENTITYRESOLUTION_INCREMENTALRESOLVER_H
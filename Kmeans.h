@@ -6,12 +6,43 @@
 #define ENTITYRESOLUTION_KMEANS_H
 
 #include <armadillo>
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <vector>
+#include "BitMatrix.h"
+#include "Parallel.h"
+
+/**
+ * Source for Kmeans::fitMiniBatch that unpacks selected packed filters (e.g. of a mapped FilterStore)
+ * into matrix columns, so only the current batch is ever dense
+ */
+template <typename T>
+struct FilterColumns {
+    BitMatrixView filters;
+
+    void operator()(const std::vector<std::size_t> &indices, arma::Mat<T> &batch) const {
+        batch.zeros(filters.nBits(), indices.size());
+        for (std::size_t j = 0; j < indices.size(); j++) {
+            T *column = batch.colptr(j);
+            for (std::size_t bit = 0; bit < filters.nBits(); bit++) {
+                column[bit] = filters.test(indices[j], bit);
+            }
+        }
+    }
+};
+
+template <typename T>
+FilterColumns<T> filterColumns(const BitMatrixView &filters) {
+    return FilterColumns<T>{filters};
+}
 
 template <typename T>
 class Kmeans {
 public:
-    Kmeans(uint8_t k) {
+    Kmeans(uint16_t k, unsigned threads = 0) {
         this->k = k;
+        this->threads = threads;
     }
 
     arma::Mat<T> getMeans() {
@@ -32,33 +63,183 @@ public:
         if(status == false) {
             std::cout << "clustering failed" << std::endl;
         }
+        this->means = means;
     }
 
-    arma::Mat<short> apply(arma::Mat<T> &data) {
-        arma::Mat<short> predictions(1, data.n_cols);
+    /**
+     * Mini-batch k-means (Sculley, 2010) for data that does not fit in memory. Each step draws a batch of
+     * points uniformly at random, assigns it to the current centroids and moves every centroid towards its
+     * new members with a per-centroid learning rate of 1 / (points seen so far). Only one batch and the
+     * centroids are held at any time. Centroids are seeded by arma::kmeans on the first batch.
+     * @param source Called as source(indices, batch) to fill column j of batch with point indices[j], e.g.
+     *               from a memory mapped filter file (see filterColumns); indices come in increasing order
+     * @param n Total number of points
+     * @param batchSize Points per batch
+     * @param noOfBatches Number of mini-batch steps
+     * @param seed Seed for batch selection
+     */
+    template <typename Source>
+    void fitMiniBatch(Source &&source, std::size_t n, std::size_t batchSize, std::size_t noOfBatches,
+                      uint64_t seed = 0) {
+        batchSize = std::min(batchSize, n);
+        if (batchSize < k) {
+            std::cout << "clustering failed" << std::endl;
+            return;
+        }
+        std::mt19937_64 rng(seed);
+        std::vector<std::size_t> indices;
+        arma::Mat<T> batch;
+        sampleBatch(rng, n, batchSize, indices);
+        source(indices, batch);
+        bool status = kmeans(means, batch, k, arma::random_spread, 10, false);
+        if (status == false) {
+            std::cout << "clustering failed" << std::endl;
+            return;
+        }
+        miniBatchSteps(source, n, batchSize, noOfBatches, rng);
+    }
 
-        for (int i = 0; i < data.n_cols; i++) {
-            arma::Col<float> datapoint = data.col(i);
+    /**
+     * Mini-batch k-means continuing from saved centroids, the streaming counterpart of the keep_existing fit
+     * @param means Initial centroids, one per column; updated in place
+     */
+    template <typename Source>
+    void fitMiniBatch(Source &&source, std::size_t n, arma::Mat<T> &means, std::size_t batchSize,
+                      std::size_t noOfBatches, uint64_t seed = 0) {
+        if (means.n_cols != k || n == 0) {
+            std::cout << "clustering failed" << std::endl;
+            return;
+        }
+        this->means = means;
+        std::mt19937_64 rng(seed);
+        miniBatchSteps(source, n, std::min(batchSize, n), noOfBatches, rng);
+        means = this->means;
+    }
 
-            double best_dist = arma::Datum<double>::inf;
-            uint8_t best_g = 0;
-            for(uint8_t g=0; g < means.n_cols; ++g)
-            {
-                const double tmp_dist = sum(square(datapoint - means.col(g)));
-                if(tmp_dist <= best_dist) {
-                    best_dist = tmp_dist;
-                    best_g = g;
+    /**
+     * Assign each column of data to its nearest centroid. Columns are processed in tiles on the worker threads,
+     * each tile's squared distances ||x||^2 - 2 x^T c + ||c||^2 coming from a single matrix product with the
+     * centroids. ||x||^2 is the same for every centroid of a point so it is left out of the arg min.
+     * The old per-column loop summed (x - c)^2 in T, whose rounding can reorder centroids at almost equal
+     * distance, so whenever another centroid is within that rounding of the nearest, the centroids in reach are
+     * measured again with the old expression and the last one wins a tie as before. Predictions are therefore
+     * those of the per-column loop; benchmarkKmeansApply in benchmark.cpp checks them against it.
+     * @param data Matrix with one data point per column
+     * @return Row of cluster predictions
+     */
+    arma::Mat<uint16_t> apply(arma::Mat<T> &data) {
+        arma::Mat<uint16_t> predictions(1, data.n_cols);
+        assign(data, arma::conv_to<arma::Mat<double>>::from(means), predictions.memptr(), &means);
+        return predictions;
+    }
+
+private:
+    static const std::size_t TileSize = 256;
+
+    /**
+     * Nearest of the given centroids for every column of data
+     * @param exact Centroids in T to settle near ties with the per-column expression, nullptr to skip that
+     */
+    void assign(const arma::Mat<T> &data, const arma::Mat<double> &centroids, uint16_t *predictions,
+                const arma::Mat<T> *exact = nullptr) {
+        if (data.n_cols == 0 || centroids.n_cols == 0) {
+            return;
+        }
+
+        arma::Row<double> centroidNorms = arma::sum(arma::square(centroids), 0);
+        arma::Mat<double> centroidsT = centroids.t();
+        double largestNorm = centroidNorms.max();
+        //Bound on how far a sum of n_rows squares in T can be off, relative to ||x||^2 + ||c||^2
+        double relativeError = 8.0 * (data.n_rows + 4) * std::numeric_limits<T>::epsilon();
+
+        parallelFor(0, data.n_cols, TileSize, [&](std::size_t begin, std::size_t end) {
+            arma::Mat<double> tile = arma::conv_to<arma::Mat<double>>::from(data.cols(begin, end - 1));
+            arma::Mat<double> cross = centroidsT * tile; //k x tile width
+            arma::Row<double> pointNorms = arma::sum(arma::square(tile), 0);
+
+            for (std::size_t j = 0; j < tile.n_cols; j++) {
+                const double *crossCol = cross.colptr(j);
+                double best_dist = arma::Datum<double>::inf;
+                uint16_t best_g = 0;
+                for (uint16_t g = 0; g < cross.n_rows; ++g) {
+                    const double tmp_dist = centroidNorms(g) - 2 * crossCol[g];
+                    if (tmp_dist <= best_dist) {
+                        best_dist = tmp_dist;
+                        best_g = g;
+                    }
+                }
+
+                //Centroids the old loop could have ranked first, measured again the way it did
+                double reach = best_dist + relativeError * (pointNorms(j) + largestNorm);
+                bool contested = false;
+                for (uint16_t g = 0; g < cross.n_rows && !contested; ++g) {
+                    contested = g != best_g && centroidNorms(g) - 2 * crossCol[g] <= reach;
+                }
+                if (contested && exact != nullptr) {
+                    arma::Col<T> datapoint = data.col(begin + j);
+                    double exact_dist = arma::Datum<double>::inf;
+                    for (uint16_t g = 0; g < cross.n_rows; ++g) {
+                        if (centroidNorms(g) - 2 * crossCol[g] > reach) {
+                            continue;
+                        }
+                        const double tmp_dist = arma::accu(arma::square(datapoint - exact->col(g)));
+                        if (tmp_dist <= exact_dist) {
+                            exact_dist = tmp_dist;
+                            best_g = g;
+                        }
+                    }
                 }
+                predictions[begin + j] = best_g;
             }
+        }, threads);
+    }
 
-            predictions[i] = best_g;
+    /**
+     * Draw batchSize of the n points uniformly at random (all of them when batchSize == n), in increasing order
+     * so a mapped source is still read front to back
+     */
+    static void sampleBatch(std::mt19937_64 &rng, std::size_t n, std::size_t batchSize,
+                            std::vector<std::size_t> &indices) {
+        indices.resize(batchSize);
+        for (std::size_t j = 0; j < batchSize; j++) {
+            indices[j] = batchSize == n ? j : rng() % n;
         }
+        std::sort(indices.begin(), indices.end());
+    }
 
-        return predictions;
+    /**
+     * Centroids stay in double for all steps and are converted to T once at the end
+     */
+    template <typename Source>
+    void miniBatchSteps(Source &source, std::size_t n, std::size_t batchSize, std::size_t noOfBatches,
+                        std::mt19937_64 &rng) {
+        arma::Mat<double> centroids = arma::conv_to<arma::Mat<double>>::from(means);
+        std::vector<uint64_t> seen(k, 0);
+        std::vector<uint16_t> predictions(batchSize);
+        std::vector<std::size_t> indices;
+        arma::Mat<T> batch;
+
+        for (std::size_t step = 0; step < noOfBatches; step++) {
+            sampleBatch(rng, n, batchSize, indices);
+            source(indices, batch);
+            assign(batch, centroids, predictions.data());
+
+            for (std::size_t j = 0; j < batch.n_cols; j++) {
+                uint16_t g = predictions[j];
+                seen[g]++;
+                double eta = 1.0 / seen[g];
+                double *centroid = centroids.colptr(g);
+                const T *point = batch.colptr(j);
+                for (std::size_t d = 0; d < batch.n_rows; d++) {
+                    centroid[d] += eta * (point[d] - centroid[d]);
+                }
+            }
+        }
+        means = arma::conv_to<arma::Mat<T>>::from(centroids);
     }
 
-private:
-    uint8_t k;
+    uint16_t k;
+    unsigned threads;
     arma::Mat<T> means;
 
 };
@@ -0,0 +1,273 @@
+//
+// Created by root on 10/16/26.
+//
+
+#ifndef ENTITYRESOLUTION_LSHINDEX_H
+#define ENTITYRESOLUTION_LSHINDEX_H
+
+#include <stdint.h>
+#include <iostream>
+#include <vector>
+#include <armadillo>
+#include "MurmurHash3.h"
+
+/**
+ * Banded LSH over MinHash signatures. A signature is cut into bands of rows values, the raw bytes of every band
+ * are hashed with MurmurHash3 seeded by the band number, and the item goes into the bucket of that key. Two items
+ * share a bucket when any band matches, which with b bands of r rows happens with probability 1 - (1 - s^r)^b
+ * for signature similarity s.
+ *
+ * Keys depend only on the band values and band number, so buckets built by different parties can be merged by
+ * key. Buckets live in a flat open addressing table (linear probing) whose slots chain into one entry array.
+ * Removing an item unlinks its entries for reuse, and a bucket left empty is deleted by shifting the rest of its
+ * probe run back, so lookups never meet a tombstone.
+ */
+class LSHIndex {
+public:
+    /**
+     * @param bands Number of bands
+     * @param rows Signature values per band
+     */
+    LSHIndex(uint16_t bands, uint16_t rows) : bands(bands), rows(rows), used(0), freeEntries(0), freeHead(NoEntry),
+                                              slots(16) {}
+
+    /**
+     * Bucket key of one band
+     * @param band Band number, the hash seed
+     * @param values rows signature values of the band
+     */
+    inline uint64_t bandKey(uint16_t band, const short *values) const {
+        uint64_t hashValue[2];
+        MurmurHash3_x64_128(values, rows * sizeof(short), band, hashValue);
+        return hashValue[0];
+    }
+
+    /**
+     * Put an item into the bucket of each of its bands
+     * @param item Item number reported back by the bucket queries
+     * @param signature At least bands * rows signature values
+     */
+    void insert(uint32_t item, const short *signature) {
+        for (uint16_t band = 0; band < bands; band++) {
+            add(bandKey(band, signature + (std::size_t) band * rows), item);
+        }
+    }
+
+    /**
+     * Take an item out of the buckets of its bands, e.g. before inserting it again with a new signature
+     * @param item Item number given to insert
+     * @param signature The signature the item was inserted with
+     */
+    void remove(uint32_t item, const short *signature) {
+        for (uint16_t band = 0; band < bands; band++) {
+            std::size_t s = locate(bandKey(band, signature + (std::size_t) band * rows));
+            if (slots[s].head == NoEntry) {
+                continue;
+            }
+            Slot &slot = slots[s];
+            uint32_t previous = NoEntry;
+            for (uint32_t e = slot.head, next; e != NoEntry; e = next) {
+                next = entries[e].next;
+                if (entries[e].item != item) {
+                    previous = e;
+                    continue;
+                }
+                if (previous == NoEntry) {
+                    slot.head = next;
+                } else {
+                    entries[previous].next = next;
+                }
+                entries[e].next = freeHead;
+                freeHead = e;
+                freeEntries++;
+            }
+            slot.tail = previous;
+            if (slot.head == NoEntry) {
+                erase(s);
+            }
+        }
+    }
+
+    /**
+     * Insert every column of a signature matrix, column c as item firstItem + c
+     * @param signatures One signature per column
+     * @param firstItem Item number of the first column
+     * @return false if the signatures are shorter than bands * rows
+     */
+    bool insert(const arma::Mat<short> &signatures, uint32_t firstItem = 0) {
+        if (signatures.n_rows < (std::size_t) bands * rows) {
+            std::cout << "signatures too short for " << bands << " bands of " << rows << " rows" << std::endl;
+            return false;
+        }
+        for (std::size_t c = 0; c < signatures.n_cols; c++) {
+            insert(firstItem + c, signatures.colptr(c));
+        }
+        return true;
+    }
+
+    /**
+     * Visit every item of one bucket in insertion order
+     * @param key Bucket key
+     * @param fn Called with each item number
+     */
+    template <typename F>
+    void forEachItem(uint64_t key, F fn) const {
+        const Slot *slot = find(key);
+        if (slot == nullptr) {
+            return;
+        }
+        for (uint32_t e = slot->head; e != NoEntry; e = entries[e].next) {
+            fn(entries[e].item);
+        }
+    }
+
+    /**
+     * Visit the items sharing a bucket with a signature, once per matching band
+     * @param signature At least bands * rows signature values
+     * @param fn Called with each item number
+     */
+    template <typename F>
+    void forEachCandidate(const short *signature, F fn) const {
+        for (uint16_t band = 0; band < bands; band++) {
+            forEachItem(bandKey(band, signature + (std::size_t) band * rows), fn);
+        }
+    }
+
+    /**
+     * Visit every bucket
+     * @param fn Called with the bucket key and a vector of its item numbers in insertion order
+     */
+    template <typename F>
+    void forEachBucket(F fn) const {
+        std::vector<uint32_t> items;
+        for (const Slot &slot: slots) {
+            if (slot.head == NoEntry) {
+                continue;
+            }
+            items.clear();
+            for (uint32_t e = slot.head; e != NoEntry; e = entries[e].next) {
+                items.push_back(entries[e].item);
+            }
+            fn(slot.key, items);
+        }
+    }
+
+    inline std::size_t bucketCount() const { return used; }
+
+    inline std::size_t entryCount() const { return entries.size() - freeEntries; }
+
+    inline uint16_t nBands() const { return bands; }
+
+    inline uint16_t nRows() const { return rows; }
+
+    void clear() {
+        std::fill(slots.begin(), slots.end(), Slot());
+        entries.clear();
+        used = 0;
+        freeEntries = 0;
+        freeHead = NoEntry;
+    }
+
+private:
+    static const uint32_t NoEntry = 0xffffffff;
+
+    struct Slot {
+        uint64_t key = 0;
+        uint32_t head = NoEntry;
+        uint32_t tail = NoEntry;
+    };
+
+    struct Entry {
+        uint32_t item;
+        uint32_t next;
+    };
+
+    inline std::size_t home(uint64_t key) const {
+        //Keys are already hashes, the top bits pick the slot
+        return (std::size_t) (key >> 32) & (slots.size() - 1);
+    }
+
+    const Slot *find(uint64_t key) const {
+        std::size_t s = locate(key);
+        return slots[s].head == NoEntry ? nullptr : &slots[s];
+    }
+
+    /**
+     * Slot of a key, or the empty slot ending its probe run
+     */
+    std::size_t locate(uint64_t key) const {
+        std::size_t s = home(key);
+        while (slots[s].head != NoEntry && slots[s].key != key) {
+            s = (s + 1) & (slots.size() - 1);
+        }
+        return s;
+    }
+
+    void add(uint64_t key, uint32_t item) {
+        //Keep the load factor at most one half
+        if (2 * (used + 1) > slots.size()) {
+            grow();
+        }
+        std::size_t s = locate(key);
+        uint32_t entry = freeHead;
+        if (entry == NoEntry) {
+            entry = entries.size();
+            entries.push_back({item, NoEntry});
+        } else {
+            freeHead = entries[entry].next;
+            freeEntries--;
+            entries[entry] = {item, NoEntry};
+        }
+        Slot &slot = slots[s];
+        if (slot.head == NoEntry) {
+            slot.key = key;
+            slot.head = entry;
+            used++;
+        } else {
+            entries[slot.tail].next = entry;
+        }
+        slot.tail = entry;
+    }
+
+    /**
+     * Empty slot s, then move back every later slot of the probe run whose home is not between s and it
+     */
+    void erase(std::size_t s) {
+        std::size_t mask = slots.size() - 1;
+        slots[s] = Slot();
+        used--;
+        for (std::size_t next = (s + 1) & mask; slots[next].head != NoEntry; next = (next + 1) & mask) {
+            std::size_t wanted = home(slots[next].key);
+            if (((next - wanted) & mask) >= ((next - s) & mask)) {
+                slots[s] = slots[next];
+                slots[next] = Slot();
+                s = next;
+            }
+        }
+    }
+
+    void grow() {
+        std::vector<Slot> previous(slots.size() * 2);
+        previous.swap(slots);
+        for (const Slot &slot: previous) {
+            if (slot.head == NoEntry) {
+                continue;
+            }
+            std::size_t s = home(slot.key);
+            while (slots[s].head != NoEntry) {
+                s = (s + 1) & (slots.size() - 1);
+            }
+            slots[s] = slot;
+        }
+    }
+
+    uint16_t bands;
+    uint16_t rows;
+    std::size_t used;
+    std::size_t freeEntries;
+    uint32_t freeHead;
+    std::vector<Slot> slots;
+    std::vector<Entry> entries;
+};
+
+#endif //ENTITYRESOLUTION_LSHINDEX_H
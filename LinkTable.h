@@ -0,0 +1,165 @@
+//
+// Created by root on 10/16/26.
+//
+
+#ifndef ENTITYRESOLUTION_LINKTABLE_H
+#define ENTITYRESOLUTION_LINKTABLE_H
+
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+#include "Parallel.h"
+
+/**
+ * Marks an entity without a link
+ */
+static const uint32_t NoLink = 0xffffffff;
+
+/**
+ * Common entity links from one party to another on dense entity IDs (filter rows). Entity i of the self party
+ * is linked to entity get(i) of the other party, so a lookup is one vector access.
+ */
+class LinkTable {
+public:
+    explicit LinkTable(std::size_t selfCount = 0) : targets(selfCount, NoLink), links(0) {}
+
+    /**
+     * Link a self entity to an other entity, replacing an earlier link of the same self entity
+     */
+    inline void link(uint32_t self, uint32_t other) {
+        if (self >= targets.size()) {
+            targets.resize(self + 1, NoLink);
+        }
+        links += targets[self] == NoLink;
+        targets[self] = other;
+    }
+
+    /**
+     * @return Linked other entity, or NoLink
+     */
+    inline uint32_t get(uint32_t self) const {
+        return self < targets.size() ? targets[self] : NoLink;
+    }
+
+    inline bool contains(uint32_t self) const {
+        return get(self) != NoLink;
+    }
+
+    /**
+     * Number of self entity slots, linked or not
+     */
+    inline std::size_t size() const { return targets.size(); }
+
+    inline std::size_t linkCount() const { return links; }
+
+    /**
+     * Take over every link of another table, its links win over existing ones
+     */
+    void merge(const LinkTable &other) {
+        for (uint32_t self = 0; self < other.size(); self++) {
+            if (other.targets[self] != NoLink) {
+                link(self, other.targets[self]);
+            }
+        }
+    }
+
+    /**
+     * Take over the links of a weaker table whose self and other entities are both still unlinked here, so
+     * merging two one-to-one tables gives a one-to-one table in which this one wins every conflict
+     * @param otherCount Number of other party entities
+     */
+    void fill(const LinkTable &weaker, std::size_t otherCount) {
+        std::vector<uint8_t> taken(otherCount, 0);
+        for (uint32_t target: targets) {
+            if (target != NoLink && target < otherCount) {
+                taken[target] = 1;
+            }
+        }
+        for (uint32_t self = 0; self < weaker.size(); self++) {
+            uint32_t target = weaker.targets[self];
+            if (target == NoLink || contains(self) || (target < otherCount && taken[target])) {
+                continue;
+            }
+            link(self, target);
+            if (target < otherCount) {
+                taken[target] = 1;
+            }
+        }
+    }
+
+    /**
+     * Same links seen from the other party
+     */
+    LinkTable inverse() const {
+        LinkTable reversed;
+        for (uint32_t self = 0; self < targets.size(); self++) {
+            if (targets[self] != NoLink) {
+                reversed.link(targets[self], self);
+            }
+        }
+        return reversed;
+    }
+
+private:
+    std::vector<uint32_t> targets;
+    std::size_t links;
+};
+
+/**
+ * Follow entities of the first party along a chain of link tables, chain[p] linking party p to party p + 1,
+ * keeping those linked at every hop. Every entity is followed independently, so the join is linear in the
+ * number of links and runs in parallel over the starting entities.
+ * @param chain Link tables along the chain
+ * @param closeRing The last table links back to the first party, and an entity is kept only when it arrives
+ * back at itself
+ * @param threads Number of threads, 0 for hardwareThreads()
+ * @return One column per party of the chain (chain.size() in a ring, chain.size() + 1 otherwise), entry g of
+ * every column being the entity of that party in common entity g
+ */
+inline std::vector<std::vector<uint32_t>> joinChain(const std::vector<const LinkTable *> &chain, bool closeRing,
+                                                    unsigned threads = 0) {
+    std::size_t parties = chain.size() + (closeRing ? 0 : 1);
+    std::vector<std::vector<uint32_t>> columns(parties);
+    if (chain.empty()) {
+        return columns;
+    }
+
+    //Fixed blocks of starting entities so the surviving groups can be concatenated in order
+    std::size_t starts = chain[0]->size();
+    std::size_t grain = 1 << 16;
+    std::size_t blocks = (starts + grain - 1) / grain;
+    std::vector<std::vector<uint32_t>> blockGroups(blocks);
+    parallelFor(0, blocks, 1, [&](std::size_t block, std::size_t) {
+        std::vector<uint32_t> &groups = blockGroups[block];
+        std::vector<uint32_t> path(parties);
+        std::size_t end = std::min(starts, (block + 1) * grain);
+        for (std::size_t start = block * grain; start < end; start++) {
+            uint32_t entity = start;
+            bool linked = true;
+            for (std::size_t hop = 0; hop < chain.size() && linked; hop++) {
+                path[hop] = entity;
+                entity = chain[hop]->get(entity);
+                linked = entity != NoLink;
+            }
+            if (!linked || (closeRing && entity != start)) {
+                continue;
+            }
+            if (!closeRing) {
+                path[parties - 1] = entity;
+            }
+            groups.insert(groups.end(), path.begin(), path.end());
+        }
+    }, threads);
+
+    //Transpose the row-major groups into one column per party
+    for (const auto &groups: blockGroups) {
+        for (std::size_t g = 0; g < groups.size(); g += parties) {
+            for (std::size_t p = 0; p < parties; p++) {
+                columns[p].push_back(groups[g + p]);
+            }
+        }
+    }
+    return columns;
+}
+
+#endif //ENTITYRESOLUTION_LINKTABLE_H
@@ -0,0 +1,94 @@
+//
+// Created by root on 10/16/26.
+//
+
+#ifndef ENTITYRESOLUTION_MAPPEDFILE_H
+#define ENTITYRESOLUTION_MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Read-only memory mapping of a whole file, unmapped when the object goes away
+ */
+class MappedFile {
+public:
+    MappedFile() : base(nullptr), length(0) {}
+
+    MappedFile(const MappedFile &) = delete;
+
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    MappedFile(MappedFile &&other) noexcept : base(other.base), length(other.length) {
+        other.base = nullptr;
+        other.length = 0;
+    }
+
+    MappedFile &operator=(MappedFile &&other) noexcept {
+        if (this != &other) {
+            close();
+            base = other.base;
+            length = other.length;
+            other.base = nullptr;
+            other.length = 0;
+        }
+        return *this;
+    }
+
+    ~MappedFile() {
+        close();
+    }
+
+    /**
+     * Map a file into memory
+     * @param path File to map
+     * @return false if the file could not be opened or mapped
+     */
+    bool open(const std::string &path) {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            ::close(fd);
+            return false;
+        }
+        length = info.st_size;
+        if (length > 0) {
+            void *mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED) {
+                ::close(fd);
+                length = 0;
+                return false;
+            }
+            base = static_cast<const char *>(mapped);
+            madvise(mapped, length, MADV_SEQUENTIAL);
+        }
+        ::close(fd);
+        return true;
+    }
+
+    void close() {
+        if (base != nullptr) {
+            munmap(const_cast<char *>(base), length);
+        }
+        base = nullptr;
+        length = 0;
+    }
+
+    inline const char *data() const { return base; }
+
+    inline std::size_t size() const { return length; }
+
+private:
+    const char *base;
+    std::size_t length;
+};
+
+#endif //ENTITYRESOLUTION_MAPPEDFILE_H
@@ -6,29 +6,97 @@
 #define ENTITYRESOLUTION_MINHASH_HPP
 
 #include <stdint.h>
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <string>
+#include <vector>
 #include <armadillo>
 #include "MurmurHash3.h"
+#include "bh.h"
+#include "BitMatrix.h"
+#include "Parallel.h"
 
+/**
+ * How MinHash draws its signature values
+ */
+enum class MinHashMode {
+    //One full permutation per signature entry
+    Permutations,
+    //One permutation split into minhashSize bins, empty bins filled in by densification
+    OnePermutation
+};
+
+/**
+ * MinHash signatures (cluster representative vectors) of discretized cluster density vectors.
+ *
+ * Permutation i maps position p of the permuted vector to bit perm_i(p), and signature entry i is the first p
+ * whose bit is set. Instead of materializing the permuted vectors, the constructor stores for every bit b and
+ * permutation i the first p with perm_i(p) == b; a signature is then the element-wise minimum of those ranks
+ * over the set bits, found by a single scan of the packed mask.
+ *
+ * In OnePermutation mode a single permutation is cut into minhashSize bins and entry i is the permuted position
+ * of the first set bit within bin i (Li et al., one permutation hashing). Bins without a set bit borrow the value of a
+ * bin picked by a per-bin probe sequence (Shrivastava, optimal densification), which keeps the collision
+ * probability of every entry equal to the Jaccard similarity. The whole state is two filterLen tables.
+ *
+ * With bBits > 0 only the lowest bBits of every value are kept (b-bit MinHash); equal signatures still
+ * collide, unequal ones collide with an extra 2^-b chance.
+ */
 class MinHash {
 public:
-    MinHash(uint8_t l, uint16_t filterLen): permutations(filterLen, l) {
-        minhashSize = l;
-        arma::Col<arma::uword> order = arma::conv_to<arma::Col<arma::uword>>::from(
-                arma::linspace(0, filterLen, filterLen));
+    //Words of the longest filter a 16-bit filter length allows
+    static const std::size_t MaxWords = 1024;
+
+    /**
+     * @param l Signature length
+     * @param filterLen Length of the vectors being signed
+     * @param mode Full permutations or one permutation hashing
+     * @param bBits Bits kept of every signature value, 0 keeps them whole
+     */
+    MinHash(uint8_t l, uint16_t filterLen, MinHashMode mode = MinHashMode::Permutations, uint8_t bBits = 0)
+            : minhashSize(l), filterLen(filterLen), mode(mode), bBits(bBits) {
+        //Hash every position key once, in lane-parallel batches
+        std::vector<std::string> keys(filterLen);
+        std::vector<const void *> keyPtrs(filterLen);
+        std::vector<int> keyLens(filterLen);
+        for (uint16_t n = 0; n < filterLen; n++) {
+            keys[n] = std::to_string(n);
+            keyPtrs[n] = keys[n].data();
+            keyLens[n] = keys[n].size();
+        }
+        std::vector<uint64_t> hashValues(2 * filterLen);
+        MurmurHash3_x64_128_batch(keyPtrs.data(), keyLens.data(), filterLen, 0, hashValues.data());
+
+        if (mode == MinHashMode::OnePermutation) {
+            //Order the bits by their hash to get one true permutation, then cut it into l bins of near equal width
+            std::vector<uint16_t> order(filterLen);
+            for (uint16_t n = 0; n < filterLen; n++) {
+                order[n] = n;
+            }
+            std::sort(order.begin(), order.end(), [&](uint16_t a, uint16_t b) {
+                return hashValues[2 * a] < hashValues[2 * b] || (hashValues[2 * a] == hashValues[2 * b] && a < b);
+            });
+            binOf.resize(filterLen);
+            permutedPosition.resize(filterLen);
+            for (uint16_t p = 0; p < filterLen; p++) {
+                binOf[order[p]] = (uint32_t) p * l / filterLen;
+                permutedPosition[order[p]] = p;
+            }
+            return;
+        }
 
-        //For the decided minhash length, create permutations and store
+        //For the decided minhash length, record the first position of each bit under every permutation
+        firstRank.assign((std::size_t) filterLen * l, filterLen);
         for (int i = 0; i < l; i++) {
             for (uint16_t n = 0; n < filterLen; n++) {
-                std::string num = std::to_string(n);
-                const char *numchar = num.c_str();
-                std::array<uint64_t, 2> hashValues = hash(numchar, num.size());
-                arma::uword val = nthHash(i, hashValues[0], hashValues[1], filterLen);
-                order(n) = val;
+                uint16_t bit = nthHash(i, hashValues[2 * n], hashValues[2 * n + 1], filterLen);
+                uint16_t &rank = firstRank[(std::size_t) bit * l + i];
+                if (n < rank) {
+                    rank = n;
+                }
             }
-            permutations.col(i) = order;
         }
-        permutations.col(0).print();
     }
 
     arma::Col<short> generateCRV(arma::Mat<float> &data, uint8_t d, bool quietPrint=true) {
@@ -37,24 +105,117 @@ public:
         display("Create density vector", quietPrint);
         arma::Col<float> denVec = getDensity(data);
 //        denVec.print();
-        //Discretize vector based on given threshold
+        return generateCRV(denVec, d, quietPrint);
+    }
+
+    /**
+     * Create the cluster representative vector straight from packed filters (e.g. a mapped cluster file)
+     * @param filters Packed filters of the cluster, one per row
+     * @param d Rank of the density threshold
+     */
+    arma::Col<short> generateCRV(const BitMatrixView &filters, uint8_t d, bool quietPrint=true) {
+        display("Creating CRV", quietPrint);
+        display("Create density vector", quietPrint);
+        arma::Col<float> denVec = getDensity(filters);
+        return generateCRV(denVec, d, quietPrint);
+    }
+
+    /**
+     * @param denVec Density of every bit, filterLen entries
+     * @param d Rank of the density threshold
+     * @return CRV, empty if the density vector does not have filterLen entries
+     */
+    arma::Col<short> generateCRV(const arma::Col<float> &denVec, uint8_t d, bool quietPrint=true) {
+        if (denVec.n_elem != filterLen) {
+            return arma::Col<short>();
+        }
+        arma::Col<short> crv(minhashSize);
+
+        //Discretize vector based on given threshold, straight into a packed mask
         display("Discretize density vector", quietPrint);
-        arma::Col<short> catVec = discretize(denVec, d);
-//        catVec.print();
+        uint64_t mask[MaxWords];
+        discretize(denVec.memptr(), denVec.n_elem, d, mask);
 
         //For the determined cluster representative vector length, create minhash signature
-        std::cout << "Creating minhash signature" << std::endl;
-        arma::Col<short> crv(minhashSize);
-        for (int i = 0; i < minhashSize; i++) {
-            //Get permutation of discretized vector
-            arma::Col<short> permutedVec = catVec.elem(permutations.col(i));
-            //Assign minhash signature value
-            crv(i) = permutedVec.index_max();
-        }
+        display("Creating minhash signature", quietPrint);
+        signature(mask, crv.memptr());
 
         return crv;
     }
 
+    /**
+     * Create the cluster representative vectors of many clusters at once, in parallel
+     * @param clusters Packed filters of each cluster
+     * @param d Rank of the density threshold
+     * @return Matrix with the CRV of cluster i in column i, empty if the filters do not have filterLen bits
+     */
+    arma::Mat<short> generateCRVs(const std::vector<BitMatrixView> &clusters, uint8_t d) {
+        arma::Mat<short> crvs(minhashSize, clusters.size());
+        std::atomic<bool> ok(true);
+        parallelFor(0, clusters.size(), 1, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t c = begin; c < end; c++) {
+                arma::Col<short> crv = generateCRV(getDensity(clusters[c]), d);
+                if (crv.n_elem == 0) {
+                    ok = false;
+                    return;
+                }
+                crvs.col(c) = crv;
+            }
+        });
+        if (!ok) {
+            crvs.reset();
+        }
+        return crvs;
+    }
+
+    /**
+     * MinHash signature of a packed bit set: entry i is the first position of the permuted vector (or bin)
+     * holding a set bit, 0 when permutation i reaches no set bit (as index_max of an all-zero vector)
+     * @param mask Packed set, filterLen bits
+     * @param out minhashSize signature values
+     */
+    void signature(const uint64_t *mask, short *out) const {
+        uint16_t ranks[256];
+        std::fill(ranks, ranks + minhashSize, filterLen);
+        std::size_t words = ((std::size_t) filterLen + 63) / 64;
+        if (mode == MinHashMode::OnePermutation) {
+            bool any = false;
+            for (std::size_t w = 0; w < words; w++) {
+                for (uint64_t word = mask[w]; word != 0; word &= word - 1) {
+                    std::size_t bit = w * 64 + __builtin_ctzll(word);
+                    uint16_t &rank = ranks[binOf[bit]];
+                    rank = permutedPosition[bit] < rank ? permutedPosition[bit] : rank;
+                    any = true;
+                }
+            }
+            if (any) {
+                densify(ranks);
+            }
+        } else {
+            for (std::size_t w = 0; w < words; w++) {
+                for (uint64_t word = mask[w]; word != 0; word &= word - 1) {
+                    const uint16_t *bitRanks = firstRank.data() + (w * 64 + __builtin_ctzll(word)) * minhashSize;
+                    for (uint8_t i = 0; i < minhashSize; i++) {
+                        ranks[i] = bitRanks[i] < ranks[i] ? bitRanks[i] : ranks[i];
+                    }
+                }
+            }
+        }
+
+        uint16_t valueMask = bBits == 0 || bBits >= 16 ? 0xffff : (uint16_t) ((1u << bBits) - 1);
+        for (uint8_t i = 0; i < minhashSize; i++) {
+            out[i] = ranks[i] == filterLen ? 0 : (short) (ranks[i] & valueMask);
+        }
+    }
+
+    inline uint8_t getSize() const {
+        return minhashSize;
+    }
+
+    inline MinHashMode getMode() const {
+        return mode;
+    }
+
     std::array<uint64_t, 2> hash(const char *data, std::size_t len) {
         std::array<uint64_t, 2> hashValue;
         MurmurHash3_x64_128(data, len, 0, hashValue.data());
@@ -63,32 +224,112 @@ public:
     }
 
     inline short nthHash(uint8_t n, uint64_t hashA, uint64_t hashB, int size) {
-        return (hashA + n * hashB) % size;
+        return reduceRange(hashA + n * hashB, size);
     }
 
     inline arma::Col<float> getDensity(arma::Mat<float> &data) {
         return arma::mean(data, 1);
     }
 
+    /**
+     * Fraction of filters having each bit set, counted on the packed words
+     */
+    arma::Col<float> getDensity(const BitMatrixView &filters) {
+        std::vector<uint32_t> counts(filters.nBits(), 0);
+        for (std::size_t i = 0; i < filters.nRows(); i++) {
+            const uint64_t *row = filters.row(i);
+            for (std::size_t w = 0; w < filters.nWords(); w++) {
+                for (uint64_t word = row[w]; word != 0; word &= word - 1) {
+                    counts[w * 64 + __builtin_ctzll(word)]++;
+                }
+            }
+        }
+        return getDensity(counts.data(), filters.nBits(), filters.nRows());
+    }
+
+    /**
+     * Density from bit counts kept elsewhere (e.g. updated incrementally)
+     * @param counts Number of members having each bit set
+     * @param bits Number of bits
+     * @param members Number of members
+     */
+    arma::Col<float> getDensity(const uint32_t *counts, std::size_t bits, std::size_t members) const {
+        arma::Col<float> density(bits);
+        for (std::size_t bit = 0; bit < bits; bit++) {
+            density(bit) = members == 0 ? 0.0f : (float) counts[bit] / members;
+        }
+        return density;
+    }
+
     inline void display(std::string mes, bool b) {
         if (!b)
             std::cout << mes << std::endl;
     }
 
-    arma::Col<short> discretize(arma::Col<float> &densityVec, uint8_t d) {
-        arma::Col<float> sorted = arma::sort(densityVec);
-        float threshold = sorted(d);
-        densityVec.elem(find(densityVec > threshold)).ones();
-        densityVec.elem(find(densityVec <= threshold)).zeros();
-
-        return arma::conv_to<arma::Col<short>>::from(densityVec);
+    /**
+     * Set the bits whose density is above the d-th smallest density (0 based)
+     * @param density Density of every bit
+     * @param len Number of bits, at most filterLen
+     * @param d Rank of the threshold, no bit is set when d >= len
+     * @param mask (len + 63) / 64 output words
+     */
+    void discretize(const float *density, std::size_t len, uint8_t d, uint64_t *mask) const {
+        if (d >= len) {
+            std::fill(mask, mask + (len + 63) / 64, 0);
+            return;
+        }
+        //Selection works on a per-thread scratch copy so the caller's densities stay untouched
+        static thread_local std::vector<float> scratch;
+        scratch.assign(density, density + len);
+        std::nth_element(scratch.begin(), scratch.begin() + d, scratch.end());
+        thresholdMask(density, len, scratch[d], mask);
     }
 
-
+    arma::Col<short> discretize(const arma::Col<float> &densityVec, uint8_t d) const {
+        std::vector<uint64_t> mask((densityVec.n_elem + 63) / 64);
+        discretize(densityVec.memptr(), densityVec.n_elem, d, mask.data());
+        arma::Col<short> catVec(densityVec.n_elem);
+        for (std::size_t bit = 0; bit < densityVec.n_elem; bit++) {
+            catVec(bit) = (mask[bit >> 6] >> (bit & 63)) & 1;
+        }
+        return catVec;
+    }
 
 private:
+    /**
+     * Fill the empty bins (rank == filterLen) of a one permutation signature from non-empty ones, bin i probing
+     * bins in its own fixed pseudo random order so the choice does not depend on which other bins are empty
+     */
+    void densify(uint16_t *ranks) const {
+        //Only bins that saw a set bit are sources, not values copied into earlier bins
+        bool empty[256];
+        for (uint16_t i = 0; i < minhashSize; i++) {
+            empty[i] = ranks[i] == filterLen;
+        }
+        for (uint16_t i = 0; i < minhashSize; i++) {
+            for (uint64_t attempt = 1; empty[i] && ranks[i] == filterLen; attempt++) {
+                //splitmix64 of (bin, attempt)
+                uint64_t z = ((uint64_t) i << 32 | attempt) * 0x9e3779b97f4a7c15ULL;
+                z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+                z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+                z ^= z >> 31;
+                uint64_t source = reduceRange(z, minhashSize);
+                if (!empty[source]) {
+                    ranks[i] = ranks[source];
+                }
+            }
+        }
+    }
+
     uint8_t minhashSize;
-    arma::Mat<arma::uword> permutations;
+    uint16_t filterLen;
+    MinHashMode mode;
+    uint8_t bBits;
+    //First permuted position of bit b under permutation i at [b * minhashSize + i], filterLen if never reached
+    std::vector<uint16_t> firstRank;
+    //Bin of bit b and its position under the single permutation
+    std::vector<uint8_t> binOf;
+    std::vector<uint16_t> permutedPosition;
 };
 
 #endif //ENTITYRESOLUTION_MINHASH_HPP
@@ -9,6 +9,12 @@
 
 #include "MurmurHash3.h"
 
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
 //-----------------------------------------------------------------------------
 // Platform-specific functions and macros
 
@@ -331,4 +337,198 @@ void MurmurHash3_x64_128 ( const void * key, const int len,
     ((uint64_t*)out)[1] = h2;
 }
 
-//-----------------------------------------------------------------------------
\ No newline at end of file
+//-----------------------------------------------------------------------------
+// Short key batches. A key below 16 bytes is only the tail step plus the
+// finalizer, and an all-zero tail word is a no-op in the tail step, so
+// zero-padded keys can run the same branch-free sequence side by side.
+
+FORCE_INLINE void hashShortBlock ( const uint64_t * block, int len, uint32_t seed, uint64_t * out )
+{
+    const uint64_t c1 = BIG_CONSTANT(0x87c37b91114253d5);
+    const uint64_t c2 = BIG_CONSTANT(0x4cf5ad432745937f);
+
+    uint64_t h1 = seed;
+    uint64_t h2 = seed;
+    uint64_t k1 = block[0];
+    uint64_t k2 = block[1];
+
+    k2 *= c2; k2  = ROTL64(k2,33); k2 *= c1; h2 ^= k2;
+    k1 *= c1; k1  = ROTL64(k1,31); k1 *= c2; h1 ^= k1;
+
+    h1 ^= len; h2 ^= len;
+
+    h1 += h2;
+    h2 += h1;
+
+    h1 = fmix64(h1);
+    h2 = fmix64(h2);
+
+    h1 += h2;
+    h2 += h1;
+
+    out[0] = h1;
+    out[1] = h2;
+}
+
+// Zero-padded little-endian load of a key below 16 bytes, using overlapping
+// word loads instead of a variable length copy
+FORCE_INLINE void loadShortKey ( const uint8_t * p, int len, uint64_t * block )
+{
+    uint64_t k1 = 0;
+    uint64_t k2 = 0;
+
+    if(len >= 8)
+    {
+        memcpy(&k1, p, 8);
+        if(len > 8)
+        {
+            memcpy(&k2, p + len - 8, 8);
+            k2 >>= 8 * (16 - len);
+        }
+    }
+    else if(len >= 4)
+    {
+        uint32_t lo, hi;
+        memcpy(&lo, p, 4);
+        memcpy(&hi, p + len - 4, 4);
+        k1 = (uint64_t)lo | ((uint64_t)hi << (8 * (len - 4)));
+    }
+    else if(len > 0)
+    {
+        k1 = (uint64_t)p[0] | ((uint64_t)p[len / 2] << (8 * (len / 2))) | ((uint64_t)p[len - 1] << (8 * (len - 1)));
+    }
+
+    block[0] = k1;
+    block[1] = k2;
+}
+
+#if defined(__AVX2__)
+
+FORCE_INLINE __m256i mul64x4 ( __m256i a, __m256i b )
+{
+#if defined(__AVX512DQ__) && defined(__AVX512VL__)
+    return _mm256_mullo_epi64(a, b);
+#else
+    __m256i lo = _mm256_mul_epu32(a, b);
+    __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b),
+                                     _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+    return _mm256_add_epi64(lo, _mm256_slli_epi64(cross, 32));
+#endif
+}
+
+#define ROTL64x4(x,r) _mm256_or_si256(_mm256_slli_epi64(x, r), _mm256_srli_epi64(x, 64 - (r)))
+
+FORCE_INLINE __m256i fmix64x4 ( __m256i k )
+{
+    k = _mm256_xor_si256(k, _mm256_srli_epi64(k, 33));
+    k = mul64x4(k, _mm256_set1_epi64x(BIG_CONSTANT(0xff51afd7ed558ccd)));
+    k = _mm256_xor_si256(k, _mm256_srli_epi64(k, 33));
+    k = mul64x4(k, _mm256_set1_epi64x(BIG_CONSTANT(0xc4ceb9fe1a85ec53)));
+    k = _mm256_xor_si256(k, _mm256_srli_epi64(k, 33));
+
+    return k;
+}
+
+// Four packed keys (blocks holds k1,k2 pairs) hashed in parallel lanes
+FORCE_INLINE void hashShortBlock4 ( const uint64_t * blocks, const int * lens, uint32_t seed, uint64_t * out )
+{
+    const __m256i c1 = _mm256_set1_epi64x(BIG_CONSTANT(0x87c37b91114253d5));
+    const __m256i c2 = _mm256_set1_epi64x(BIG_CONSTANT(0x4cf5ad432745937f));
+
+    // De-interleave (k1,k2) pairs of 4 keys into a k1 vector and a k2 vector
+    __m256i ab = _mm256_loadu_si256((const __m256i *)(blocks));
+    __m256i cd = _mm256_loadu_si256((const __m256i *)(blocks + 4));
+    __m256i k1 = _mm256_permute4x64_epi64(_mm256_unpacklo_epi64(ab, cd), 0xD8);
+    __m256i k2 = _mm256_permute4x64_epi64(_mm256_unpackhi_epi64(ab, cd), 0xD8);
+
+    __m256i len = _mm256_setr_epi64x(lens[0], lens[1], lens[2], lens[3]);
+    __m256i h1 = _mm256_set1_epi64x(seed);
+    __m256i h2 = h1;
+
+    k2 = mul64x4(k2, c2); k2 = ROTL64x4(k2, 33); k2 = mul64x4(k2, c1); h2 = _mm256_xor_si256(h2, k2);
+    k1 = mul64x4(k1, c1); k1 = ROTL64x4(k1, 31); k1 = mul64x4(k1, c2); h1 = _mm256_xor_si256(h1, k1);
+
+    h1 = _mm256_xor_si256(h1, len); h2 = _mm256_xor_si256(h2, len);
+
+    h1 = _mm256_add_epi64(h1, h2);
+    h2 = _mm256_add_epi64(h2, h1);
+
+    h1 = fmix64x4(h1);
+    h2 = fmix64x4(h2);
+
+    h1 = _mm256_add_epi64(h1, h2);
+    h2 = _mm256_add_epi64(h2, h1);
+
+    // Re-interleave into (h1,h2) pairs per key
+    __m256i lo = _mm256_unpacklo_epi64(h1, h2);
+    __m256i hi = _mm256_unpackhi_epi64(h1, h2);
+    _mm256_storeu_si256((__m256i *)(out), _mm256_permute2x128_si256(lo, hi, 0x20));
+    _mm256_storeu_si256((__m256i *)(out + 4), _mm256_permute2x128_si256(lo, hi, 0x31));
+}
+
+#endif // defined(__AVX2__)
+
+void MurmurHash3_x64_128_short ( const uint64_t * blocks, const int * lens, int count,
+                                 uint32_t seed, uint64_t * out )
+{
+    int i = 0;
+
+#if defined(__AVX2__)
+    for(; i + 4 <= count; i += 4)
+    {
+        hashShortBlock4(blocks + i*2, lens + i, seed, out + i*2);
+    }
+#endif
+
+    for(; i < count; i++)
+    {
+        hashShortBlock(blocks + i*2, lens[i], seed, out + i*2);
+    }
+}
+
+void MurmurHash3_x64_128_batch ( const void * const * keys, const int * lens, int count,
+                                 uint32_t seed, uint64_t * out )
+{
+    const int lanes = 8;
+    uint64_t blocks[lanes*2];
+    int shortLens[lanes];
+    int shortIndex[lanes];
+    uint64_t hashes[lanes*2];
+
+    int pending = 0;
+    for(int i = 0; i < count; i++)
+    {
+        if(lens[i] >= 16)
+        {
+            MurmurHash3_x64_128(keys[i], lens[i], seed, out + i*2);
+            continue;
+        }
+
+        loadShortKey((const uint8_t *)keys[i], lens[i], blocks + pending*2);
+        shortLens[pending] = lens[i];
+        shortIndex[pending] = i;
+
+        if(++pending == lanes)
+        {
+            MurmurHash3_x64_128_short(blocks, shortLens, pending, seed, hashes);
+            for(int p = 0; p < pending; p++)
+            {
+                out[shortIndex[p]*2] = hashes[p*2];
+                out[shortIndex[p]*2+1] = hashes[p*2+1];
+            }
+            pending = 0;
+        }
+    }
+
+    if(pending > 0)
+    {
+        MurmurHash3_x64_128_short(blocks, shortLens, pending, seed, hashes);
+        for(int p = 0; p < pending; p++)
+        {
+            out[shortIndex[p]*2] = hashes[p*2];
+            out[shortIndex[p]*2+1] = hashes[p*2+1];
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
@@ -31,5 +31,18 @@ void MurmurHash3_x86_128 ( const void * key, int len, uint32_t seed, void * out
 
 void MurmurHash3_x64_128 ( const void * key, int len, uint32_t seed, void * out );
 
+//-----------------------------------------------------------------------------
+// Batched x64_128 for many short keys. Results are identical to calling
+// MurmurHash3_x64_128 per key; out receives two uint64_t per key.
+
+// Keys already packed into 16-byte zero-padded blocks (two uint64_t per key),
+// every len must be below 16. Hashed 4 lanes at a time when AVX2 is available.
+void MurmurHash3_x64_128_short ( const uint64_t * blocks, const int * lens, int count,
+                                 uint32_t seed, uint64_t * out );
+
+// Arbitrary keys; short keys go through the lane path, long ones are hashed singly.
+void MurmurHash3_x64_128_batch ( const void * const * keys, const int * lens, int count,
+                                 uint32_t seed, uint64_t * out );
+
 //-----------------------------------------------------------------------------
 #endif //ENTITYRESOLUTION_MURMURHASH3_H
@@ -0,0 +1,167 @@
+//
+// Created by root on 10/16/26.
+//
+
+#ifndef ENTITYRESOLUTION_PARALLEL_H
+#define ENTITYRESOLUTION_PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Number of worker threads to use when the caller does not specify one
+ */
+inline unsigned hardwareThreads() {
+    unsigned n = std::thread::hardware_concurrency();
+    return n == 0 ? 1 : n;
+}
+
+/**
+ * Run fn(chunkBegin, chunkEnd) over [begin, end) split into chunks of grain items. Threads claim the next
+ * chunk from a shared counter, so uneven chunks balance out across workers. The calling thread takes part.
+ * @param begin First index
+ * @param end One past the last index
+ * @param grain Items per chunk
+ * @param fn Chunk callback, called concurrently
+ * @param threads Number of threads, 0 for hardwareThreads()
+ */
+template <typename F>
+void parallelFor(std::size_t begin, std::size_t end, std::size_t grain, F &&fn, unsigned threads = 0) {
+    if (begin >= end) {
+        return;
+    }
+    if (grain == 0) {
+        grain = 1;
+    }
+    std::size_t chunks = (end - begin + grain - 1) / grain;
+    if (threads == 0) {
+        threads = hardwareThreads();
+    }
+    if (threads > chunks) {
+        threads = (unsigned) chunks;
+    }
+
+    std::atomic<std::size_t> nextChunk(0);
+    auto worker = [&]() {
+        for (std::size_t chunk = nextChunk++; chunk < chunks; chunk = nextChunk++) {
+            std::size_t chunkBegin = begin + chunk * grain;
+            std::size_t chunkEnd = chunkBegin + grain < end ? chunkBegin + grain : end;
+            fn(chunkBegin, chunkEnd);
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; t++) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto &thread: pool) {
+        thread.join();
+    }
+}
+
+/**
+ * Multi-producer multi-consumer FIFO with a fixed capacity. push blocks while the queue is full, so a fast
+ * producer cannot run ahead of the consumer by more than the capacity.
+ */
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(std::size_t capacity) : capacity(capacity == 0 ? 1 : capacity), closed(false) {}
+
+    void push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this]() { return items.size() < capacity || closed; });
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+    }
+
+    /**
+     * Take the next item, waiting for one if needed
+     * @return false once the queue is closed and drained
+     */
+    bool pop(T &item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this]() { return !items.empty() || closed; });
+        if (items.empty()) {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    /**
+     * Signal that no more items will be pushed
+     */
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+
+private:
+    std::size_t capacity;
+    bool closed;
+    std::deque<T> items;
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+};
+
+/**
+ * Sort a vector on several threads: equal blocks are sorted concurrently, then merged pairwise in rounds,
+ * each round merging its pairs concurrently into a second buffer
+ * @param items Items to sort
+ * @param less Strict weak ordering
+ * @param threads Number of threads, 0 for hardwareThreads()
+ */
+template <typename T, typename Compare>
+void parallelSort(std::vector<T> &items, Compare less, unsigned threads = 0) {
+    if (threads == 0) {
+        threads = hardwareThreads();
+    }
+    std::size_t n = items.size();
+    std::size_t blocks = std::min<std::size_t>(threads, n / 4096 + 1);
+    if (blocks <= 1) {
+        std::sort(items.begin(), items.end(), less);
+        return;
+    }
+
+    std::vector<std::size_t> bounds(blocks + 1);
+    for (std::size_t b = 0; b <= blocks; b++) {
+        bounds[b] = n * b / blocks;
+    }
+    parallelFor(0, blocks, 1, [&](std::size_t b, std::size_t) {
+        std::sort(items.begin() + bounds[b], items.begin() + bounds[b + 1], less);
+    }, threads);
+
+    std::vector<T> buffer(n);
+    std::vector<T> *from = &items;
+    std::vector<T> *to = &buffer;
+    for (std::size_t width = 1; width < blocks; width *= 2) {
+        std::size_t pairs = (blocks + 2 * width - 1) / (2 * width);
+        parallelFor(0, pairs, 1, [&](std::size_t pair, std::size_t) {
+            std::size_t first = pair * 2 * width;
+            std::size_t begin = bounds[first];
+            std::size_t middle = bounds[std::min(first + width, blocks)];
+            std::size_t end = bounds[std::min(first + 2 * width, blocks)];
+            std::merge(from->begin() + begin, from->begin() + middle, from->begin() + middle, from->begin() + end,
+                       to->begin() + begin, less);
+        }, threads);
+        std::swap(from, to);
+    }
+    if (from != &items) {
+        items.swap(buffer);
+    }
+}
+
+#endif //ENTITYRESOLUTION_PARALLEL_H
@@ -0,0 +1,361 @@
+//
+// Created by root on 10/16/26.
+//
+
+#ifndef ENTITYRESOLUTION_PIPELINE_H
+#define ENTITYRESOLUTION_PIPELINE_H
+
+#include <stdint.h>
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <armadillo>
+#include "BinaryKmeans.h"
+#include "BitMatrix.h"
+#include "ClusterPartitioner.h"
+#include "EntityGraph.h"
+#include "FilterComparator.h"
+#include "FilterEncoder.h"
+#include "FilterStore.h"
+#include "LinkTable.h"
+#include "LSHIndex.h"
+#include "MinHash.hpp"
+#include "Parallel.h"
+#include "Trace.h"
+
+/**
+ * Settings of every stage of one party
+ */
+struct PipelineConfig {
+    std::string entityPath = "entityData.txt";
+    std::string edgePath = "edgelist.txt";
+    //Directory stage results are written to as they are produced, empty to keep everything in memory
+    std::string checkpointDir;
+
+    uint64_t filterSize = 256;
+    uint8_t numHashes = 4;
+    //Hash functions per neighbour at each structural hop, and the most neighbours sampled per vertex
+    std::vector<uint8_t> hopHashes{4, 2};
+    uint32_t degreeCap = 64;
+
+    uint16_t clusters = 3;
+    uint16_t iterations = 10;
+    uint64_t seed = 0;
+
+    uint8_t minhashSize = 100;
+    uint8_t densityRank = 50;
+    uint16_t bands = 10;
+    uint16_t rows = 10;
+
+    float similarityThreshold = 0.9;
+    AssignmentMode assignment = AssignmentMode::Greedy;
+
+    unsigned threads = 0;
+};
+
+/**
+ * Output of the encode stage, row i of both matrices belongs to entity ids[i]
+ */
+struct EncodedFilters {
+    std::vector<int64_t> ids;
+    BitMatrix attrFilters;
+    BitMatrix structFilters;
+};
+
+/**
+ * Output of the cluster stage, pred[i] is the cluster of encoded row i
+ */
+struct ClusterModel {
+    BitMatrix means;
+    std::vector<uint16_t> pred;
+};
+
+/**
+ * Everything a party shares or compares after the local stages. Filters are held once, grouped by cluster in the
+ * partition; the CRV of cluster c is column c and cluster c is item c of the LSH index.
+ */
+struct PartyResult {
+    PartyResult(uint16_t bands, uint16_t rows) : index(bands, rows) {}
+
+    ClusterModel clustering;
+    ClusterPartition partition;
+    arma::Mat<short> crvs;
+    LSHIndex index;
+};
+
+/**
+ * The resolution pipeline of one party as stages with typed in-memory outputs:
+ *
+ *   ingest -> encode -> cluster -> partition -> CRV -> LSH          (run, per party)
+ *   compare                                                          (link, per pair of parties)
+ *
+ * Each stage takes the previous results by reference or by move, so nothing is written and read back between
+ * stages. Filters are encoded straight into their matrices and copied once more, when the partition regroups
+ * them by cluster; the encoded matrices are released right after. With a checkpoint directory every stage also persists its
+ * output there, in the binary filter format for filters and centroids and arma_binary for the CRVs.
+ */
+class PartyPipeline {
+public:
+    explicit PartyPipeline(PipelineConfig config)
+            : config(std::move(config)),
+              threads(this->config.threads == 0 ? hardwareThreads() : this->config.threads) {}
+
+    /**
+     * Run every local stage
+     * @param result Receives the partition, CRVs and LSH buckets
+     * @return false if the input could not be read, clustering failed or the CRVs could not be made
+     */
+    bool run(PartyResult &result) const {
+        TRACE_SCOPE("pipeline");
+        EntityTable entities;
+        CsrGraph graph;
+        if (!ingest(entities, graph)) {
+            return false;
+        }
+        EncodedFilters encoded = encode(entities, graph);
+        if (!cluster(encoded, result.clustering)) {
+            return false;
+        }
+        result.partition = partition(encoded, result.clustering);
+        //Filters live on in the partition only
+        encoded = EncodedFilters();
+        if (!representatives(result.partition, result.crvs)) {
+            return false;
+        }
+        return buckets(result.crvs, result.index);
+    }
+
+    bool ingest(EntityTable &entities, CsrGraph &graph) const {
+        TRACE_SCOPE("ingest");
+        if (!entities.load(config.entityPath, threads)) {
+            std::cout << "could not read entity data " << config.entityPath << std::endl;
+            return false;
+        }
+        if (!graph.load(config.edgePath, entities, threads)) {
+            std::cout << "could not read edge list " << config.edgePath << std::endl;
+            return false;
+        }
+        TRACE_COUNT("records", entities.size());
+        TRACE_COUNT("edges", graph.edgeCount());
+        TRACE_COUNT("bytes", entities.inputBytes() + graph.inputBytes());
+        return true;
+    }
+
+    /**
+     * Attribute and structural filters of every entity, in entity row order, encoded in place
+     */
+    EncodedFilters encode(const EntityTable &entities, const CsrGraph &graph) const {
+        TRACE_SCOPE("encode");
+        EncodedFilters encoded;
+        encoded.ids = entities.allIds();
+        encoded.attrFilters = BitMatrix(entities.size(), config.filterSize);
+        encoded.structFilters = BitMatrix(entities.size(), config.filterSize);
+
+        FilterEncoder encoder(config.filterSize, config.numHashes,
+                              StructuralEncoder(config.filterSize, config.hopHashes, config.degreeCap, config.seed,
+                                                threads), 4096, threads);
+        encoder.encodeInto(entities, graph, encoded.attrFilters, encoded.structFilters);
+        if (!config.checkpointDir.empty()) {
+            FilterStoreWriter attrWriter;
+            FilterStoreWriter structWriter;
+            checkpointed(attrWriter.open(path("attrfilters.bin"), config.filterSize) &&
+                         structWriter.open(path("structfilters.bin"), config.filterSize));
+            attrWriter.append(encoded.ids, encoded.attrFilters.view());
+            structWriter.append(encoded.ids, encoded.structFilters.view());
+            checkpointed(attrWriter.close() && structWriter.close());
+        }
+        TRACE_COUNT("records", entities.size());
+        TRACE_COUNT("allocated bytes", 2 * entities.size() * encoded.attrFilters.nWords() * sizeof(uint64_t));
+        return encoded;
+    }
+
+    /**
+     * k-modes clustering of the attribute filters
+     * @return false if there are fewer entities than clusters
+     */
+    bool cluster(const EncodedFilters &encoded, ClusterModel &model) const {
+        BinaryKmeans kmeans(config.clusters, threads);
+        {
+            TRACE_SCOPE("kmeans fit");
+            if (!kmeans.fit(encoded.attrFilters.view(), config.iterations, config.seed)) {
+                return false;
+            }
+            //Distances plain Lloyd iterations would compute, less those the bounds skipped
+            TRACE_COUNT("records", encoded.attrFilters.nRows());
+            TRACE_COUNT("distances", kmeans.distanceCount());
+            TRACE_COUNT("distances pruned", prunedCount((uint64_t) encoded.attrFilters.nRows() * config.clusters *
+                                                        kmeans.iterationCount(), kmeans.distanceCount()));
+        }
+        {
+            TRACE_SCOPE("kmeans apply");
+            model.pred = kmeans.apply(encoded.attrFilters.view());
+            TRACE_COUNT("records", model.pred.size());
+        }
+        model.means = kmeans.getMeans();
+        if (!config.checkpointDir.empty()) {
+            std::vector<int64_t> clusterIds(model.means.nRows());
+            for (std::size_t c = 0; c < clusterIds.size(); c++) {
+                clusterIds[c] = c;
+            }
+            FilterStoreWriter writer;
+            checkpointed(writer.open(path("means.bin"), config.filterSize));
+            writer.append(clusterIds, model.means.view());
+            checkpointed(writer.close());
+        }
+        return true;
+    }
+
+    /**
+     * Attribute and structural filters grouped by cluster
+     */
+    ClusterPartition partition(const EncodedFilters &encoded, const ClusterModel &model) const {
+        TRACE_SCOPE("partition");
+        ClusterPartitioner partitioner(threads);
+        ClusterPartition partition = partitioner.partition(encoded.attrFilters.view(), encoded.structFilters.view(),
+                                                           encoded.ids.data(), model.pred, model.means.nRows());
+        if (!config.checkpointDir.empty()) {
+            checkpointed(partitioner.save(partition, path("attrfilterscluster"), path("structfilterscluster")));
+        }
+        TRACE_COUNT("records", partition.ids.size());
+        TRACE_COUNT("allocated bytes", 2 * partition.ids.size() * partition.attrFilters.nWords() * sizeof(uint64_t));
+        return partition;
+    }
+
+    /**
+     * CRV of every cluster from its attribute filters, one column per cluster
+     * @return false if the filter size does not match the MinHash filter length
+     */
+    bool representatives(const ClusterPartition &partition, arma::Mat<short> &crvs) const {
+        TRACE_SCOPE("generateCRV");
+        std::vector<BitMatrixView> clusterViews(partition.size());
+        for (std::size_t c = 0; c < partition.size(); c++) {
+            clusterViews[c] = partition.attrCluster(c);
+        }
+        MinHash minHash(config.minhashSize, config.filterSize);
+        crvs = minHash.generateCRVs(clusterViews, config.densityRank);
+        if (crvs.n_cols != partition.size()) {
+            std::cout << "filters have " << partition.attrFilters.nBits() << " bits, MinHash expects "
+                      << config.filterSize << std::endl;
+            return false;
+        }
+        if (!config.checkpointDir.empty()) {
+            checkpointed(crvs.save(path("crvs.bin"), arma::arma_binary));
+        }
+        TRACE_COUNT("clusters", partition.size());
+        TRACE_COUNT("records", partition.ids.size());
+        return true;
+    }
+
+    /**
+     * LSH buckets of the CRVs, cluster c as item c
+     * @return false if the CRVs are shorter than bands * rows
+     */
+    bool buckets(const arma::Mat<short> &crvs, LSHIndex &index) const {
+        TRACE_SCOPE("lsh banding");
+        index.clear();
+        if (crvs.n_cols > 0 && !index.insert(crvs)) {
+            return false;
+        }
+        TRACE_COUNT("clusters", crvs.n_cols);
+        TRACE_COUNT("buckets", index.bucketCount());
+        return true;
+    }
+
+    /**
+     * Compare stage between two parties: clusters sharing an LSH bucket are compared on their attribute and on
+     * their structural filters, the candidates of each filter kind assigned one-to-one over all cluster pairs.
+     * Structural links win, and an attribute link is kept only where neither of its entities has a structural
+     * link, so every entity of either party is in at most one link.
+     * @return Links from self partition rows to other partition rows, entity IDs via partition.ids
+     */
+    LinkTable link(const PartyResult &self, const PartyResult &other) const {
+        TRACE_SCOPE("compareFilters");
+        //Candidate cluster pairs, every bucket key of self looked up in the other index
+        std::vector<uint64_t> packed;
+        self.index.forEachBucket([&](uint64_t key, const std::vector<uint32_t> &selfClusters) {
+            other.index.forEachItem(key, [&](uint32_t otherCluster) {
+                for (uint32_t selfCluster: selfClusters) {
+                    packed.push_back((uint64_t) selfCluster << 32 | otherCluster);
+                }
+            });
+        });
+        std::sort(packed.begin(), packed.end());
+        packed.erase(std::unique(packed.begin(), packed.end()), packed.end());
+        std::vector<ClusterPair> pairs;
+        for (uint64_t pair: packed) {
+            pairs.push_back({(uint32_t) (pair >> 32), (uint32_t) pair});
+        }
+
+        LinkTable links(self.partition.ids.size());
+        LinkTable attrLinks(self.partition.ids.size());
+        FilterComparator comparator(config.similarityThreshold, threads);
+        for (bool structural: {false, true}) {
+            std::vector<BitMatrixView> selfViews(self.partition.size());
+            std::vector<BitMatrixView> otherViews(other.partition.size());
+            for (std::size_t c = 0; c < selfViews.size(); c++) {
+                selfViews[c] = structural ? self.partition.structCluster(c) : self.partition.attrCluster(c);
+            }
+            for (std::size_t c = 0; c < otherViews.size(); c++) {
+                otherViews[c] = structural ? other.partition.structCluster(c) : other.partition.attrCluster(c);
+            }
+            std::vector<FilterMatch> candidates = comparator.candidates(selfViews, otherViews, pairs);
+
+            //A cluster may meet several clusters of the other party, so candidates of all pairs are assigned
+            //together on partition rows, grouped by self row as assign() expects
+            for (FilterMatch &match: candidates) {
+                match.selfRow += self.partition.offsets[pairs[match.pair].self];
+                match.otherRow += other.partition.offsets[pairs[match.pair].other];
+                match.pair = 0;
+            }
+            std::sort(candidates.begin(), candidates.end(), [](const FilterMatch &a, const FilterMatch &b) {
+                if (a.selfRow != b.selfRow) {
+                    return a.selfRow < b.selfRow;
+                }
+                return a.score != b.score ? a.score > b.score : a.otherRow < b.otherRow;
+            });
+            LinkTable &passLinks = structural ? links : attrLinks;
+            for (const FilterMatch &match: comparator.assign(candidates, config.assignment)) {
+                passLinks.link(match.selfRow, match.otherRow);
+            }
+            //Every filter pair of the two parties outside the candidate cluster pairs was never scored
+            TRACE_COUNT("comparisons", comparator.comparisonCount());
+            TRACE_COUNT("comparisons pruned", prunedCount((uint64_t) self.partition.ids.size() *
+                                                          other.partition.ids.size(), comparator.comparisonCount()));
+            TRACE_COUNT("candidates", candidates.size());
+        }
+        links.fill(attrLinks, other.partition.ids.size());
+        TRACE_COUNT("cluster pairs", pairs.size());
+        TRACE_COUNT("links", links.linkCount());
+        return links;
+    }
+
+    inline const PipelineConfig &getConfig() const { return config; }
+
+    /**
+     * Work skipped out of all possible work, for the trace counters
+     */
+    static inline uint64_t prunedCount(uint64_t all, uint64_t done) {
+        return all - std::min(all, done);
+    }
+
+private:
+    inline std::string path(const std::string &file) const {
+        return config.checkpointDir + "/" + file;
+    }
+
+    /**
+     * Report a failed checkpoint write, the in-memory stage result stays valid
+     */
+    inline void checkpointed(bool written) const {
+        if (!written) {
+            std::cout << "could not write checkpoint in " << config.checkpointDir << std::endl;
+        }
+    }
+
+    PipelineConfig config;
+    unsigned threads;
+};
+
+#endif //ENTITYRESOLUTION_PIPELINE_H
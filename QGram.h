@@ -0,0 +1,155 @@
+//
+// Created by root on 10/16/26.
+//
+
+#ifndef ENTITYRESOLUTION_QGRAM_H
+#define ENTITYRESOLUTION_QGRAM_H
+
+#include <stdint.h>
+#include <cstddef>
+#include <string_view>
+
+/**
+ * Splits a string into overlapping q-grams without copying. Each gram is handed to a callback as a pointer
+ * into the source buffer plus a byte length; only grams that overlap the optional padding are assembled,
+ * and those go through a small stack buffer, so tokenizing never touches the heap.
+ *
+ * With utf8 enabled a gram is q code points instead of q bytes, so multi-byte characters are never split.
+ * Strings shorter than q (and not padded) produce a single gram holding the whole string.
+ */
+class QGramTokenizer {
+public:
+    static const uint8_t MaxQ = 8;
+
+    QGramTokenizer(uint8_t q = 2, bool padding = false, bool utf8 = false, char padChar = '_')
+            : q(q < 1 ? 1 : (q > MaxQ ? MaxQ : q)),
+              padding(padding),
+              utf8(utf8),
+              padChar(padChar) {}
+
+    /**
+     * Call fn(const char *gram, std::size_t len) for every q-gram of str
+     * @param str Source string, must outlive the call
+     * @param fn Callback receiving each gram
+     */
+    template <typename F>
+    void forEach(std::string_view str, F &&fn) const {
+        if (str.empty()) {
+            return;
+        }
+
+        //Byte grams without padding are plain fixed-width windows over the buffer
+        if (!padding && !utf8) {
+            if (str.size() < q) {
+                fn(str.data(), str.size());
+                return;
+            }
+            for (std::size_t i = 0; i + q <= str.size(); i++) {
+                fn(str.data() + i, (std::size_t) q);
+            }
+            return;
+        }
+
+        //Ring of the last q tokens, a token is one character (byte or code point) or a pad when len == 0
+        Token window[MaxQ];
+        std::size_t seen = 0;
+        std::size_t pads = 0; //Pads currently inside the window
+        uint8_t next = 0; //Ring slot to overwrite, which is the oldest token once the ring is full
+
+        auto push = [&](std::size_t offset, std::size_t len) {
+            Token &slot = window[next];
+            if (seen >= q && slot.len == 0) {
+                pads--;
+            }
+            slot.offset = offset;
+            slot.len = len;
+            if (len == 0) {
+                pads++;
+            }
+            seen++;
+            next = next + 1 == q ? 0 : next + 1;
+            if (seen >= q) {
+                emit(str, window, next, pads, fn);
+            }
+        };
+
+        if (padding) {
+            for (uint8_t i = 1; i < q; i++) {
+                push(0, 0);
+            }
+        }
+
+        std::size_t pos = 0;
+        while (pos < str.size()) {
+            std::size_t len = utf8 ? codePointLength(str, pos) : 1;
+            push(pos, len);
+            pos += len;
+        }
+
+        if (padding) {
+            for (uint8_t i = 1; i < q; i++) {
+                push(0, 0);
+            }
+        } else if (seen < q) {
+            fn(str.data(), str.size());
+        }
+    }
+
+    inline uint8_t gramLength() const {
+        return q;
+    }
+
+private:
+    struct Token {
+        std::size_t offset;
+        std::size_t len;
+    };
+
+    /**
+     * Byte length of the UTF-8 sequence starting at pos; malformed lead bytes count as a single byte
+     */
+    static inline std::size_t codePointLength(std::string_view str, std::size_t pos) {
+        uint8_t lead = (uint8_t) str[pos];
+        std::size_t len = 1;
+        if ((lead & 0xE0) == 0xC0) {
+            len = 2;
+        } else if ((lead & 0xF0) == 0xE0) {
+            len = 3;
+        } else if ((lead & 0xF8) == 0xF0) {
+            len = 4;
+        }
+        return pos + len <= str.size() ? len : str.size() - pos;
+    }
+
+    template <typename F>
+    inline void emit(std::string_view str, const Token *window, uint8_t first, std::size_t pads, F &fn) const {
+        if (pads == 0) {
+            const Token &last = window[first == 0 ? q - 1 : first - 1];
+            std::size_t begin = window[first].offset;
+            fn(str.data() + begin, last.offset + last.len - begin);
+            return;
+        }
+
+        //Gram overlaps the padding, assemble it on the stack
+        char buffer[MaxQ * 4];
+        std::size_t len = 0;
+        for (uint8_t i = 0, slot = first; i < q; i++, slot = slot + 1 == q ? 0 : slot + 1) {
+            const Token &token = window[slot];
+            if (token.len == 0) {
+                buffer[len++] = padChar;
+            } else {
+                for (std::size_t b = 0; b < token.len; b++) {
+                    buffer[len++] = str[token.offset + b];
+                }
+            }
+        }
+        fn(buffer, len);
+    }
+
+    uint8_t q;
+    bool padding;
+    bool utf8;
+    char padChar;
+};
+
+#endif //ENTITYRESOLUTION_QGRAM_H
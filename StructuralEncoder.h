@@ -0,0 +1,177 @@
+//
+// Created by root on 10/16/26.
+//
+
+#ifndef ENTITYRESOLUTION_STRUCTURALENCODER_H
+#define ENTITYRESOLUTION_STRUCTURALENCODER_H
+
+#include <stdint.h>
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include "bh.h"
+#include "BitMatrix.h"
+#include "EntityGraph.h"
+#include "Parallel.h"
+
+/**
+ * Structural Bloom filters over a CSR graph. The filter of a vertex holds the first attribute of every vertex
+ * within hopHashes.size() hops, inserted with hopHashes[h] hash functions at hop h + 1 so that near neighbours
+ * weigh more than far ones. Every vertex counts once, at its nearest hop, and the vertex itself is left out.
+ *
+ * Hubs are bounded by degreeCap: a vertex with more neighbours contributes a uniform sample of degreeCap of them,
+ * and a hop reaching more than degreeCap new vertices keeps a sample of degreeCap. Samples are drawn with Floyd's
+ * algorithm from a generator seeded by (seed, entity ID, hop), so they take O(degreeCap) time whatever the degree
+ * and the same graph always gives the same filters, even after other entities are added or removed. Encoding one
+ * vertex costs at most hops * degreeCap * degreeCap neighbour visits.
+ */
+class StructuralEncoder {
+public:
+    /**
+     * Per thread working memory, visited marks are stamped with a counter so they never need clearing
+     */
+    struct Scratch {
+        std::vector<uint32_t> visited;
+        uint32_t stamp = 0;
+        std::vector<uint32_t> frontier;
+        std::vector<uint32_t> next;
+        std::vector<uint32_t> sample;
+    };
+
+    /**
+     * @param filterSize Filter length in bits
+     * @param hopHashes Hash functions per neighbour at each hop, its length is the number of hops
+     * @param degreeCap Most neighbours taken from one vertex and most vertices kept per hop
+     * @param seed Seed of the sampling
+     * @param threads Number of threads for encodeRows, 0 for hardwareThreads()
+     */
+    StructuralEncoder(uint64_t filterSize, std::vector<uint8_t> hopHashes, uint32_t degreeCap = 64,
+                      uint64_t seed = 0, unsigned threads = 0)
+            : filterSize(filterSize),
+              hopHashes(std::move(hopHashes)),
+              degreeCap(degreeCap == 0 ? 1 : degreeCap),
+              seed(seed),
+              threads(threads == 0 ? hardwareThreads() : threads) {}
+
+    /**
+     * Encode the structural filter of one vertex
+     * @param vertex Entity row
+     * @param entities Attributes of every entity row
+     * @param graph Neighbours of every entity row
+     * @param filter Filter to insert into, not reset here
+     * @param scratch Working memory of the calling thread
+     */
+    void encode(uint32_t vertex, const EntityTable &entities, const CsrGraph &graph, BloomFilter &filter,
+                Scratch &scratch) const {
+        if (scratch.visited.size() < graph.size()) {
+            scratch.visited.assign(graph.size(), 0);
+            scratch.stamp = 0;
+        }
+        if (++scratch.stamp == 0) {
+            std::fill(scratch.visited.begin(), scratch.visited.end(), 0);
+            scratch.stamp = 1;
+        }
+        if (vertex >= graph.size()) {
+            return;
+        }
+
+        scratch.visited[vertex] = scratch.stamp;
+        scratch.frontier.assign(1, vertex);
+        for (std::size_t hop = 0; hop < hopHashes.size() && !scratch.frontier.empty(); hop++) {
+            scratch.next.clear();
+            for (uint32_t from: scratch.frontier) {
+                const uint32_t *neighbours = graph.begin(from);
+                std::size_t degree = graph.degree(from);
+                if (degree <= degreeCap) {
+                    for (std::size_t n = 0; n < degree; n++) {
+                        visit(neighbours[n], scratch);
+                    }
+                } else {
+                    sampleIndices(degree, mix(entities.id(vertex), entities.id(from), hop), scratch.sample);
+                    for (uint32_t n: scratch.sample) {
+                        visit(neighbours[n], scratch);
+                    }
+                }
+            }
+            //Keep a hop to at most degreeCap vertices as well
+            if (scratch.next.size() > degreeCap) {
+                sampleIndices(scratch.next.size(), mix(entities.id(vertex), entities.id(vertex), hop + hopHashes.size()),
+                              scratch.sample);
+                for (std::size_t k = 0; k < scratch.sample.size(); k++) {
+                    scratch.sample[k] = scratch.next[scratch.sample[k]];
+                }
+                scratch.next.swap(scratch.sample);
+            }
+            for (uint32_t neighbour: scratch.next) {
+                if (entities.attributeCount(neighbour) > 0) {
+                    filter.insert(entities.attribute(neighbour, 0), hopHashes[hop]);
+                }
+            }
+            scratch.frontier.swap(scratch.next);
+        }
+    }
+
+    /**
+     * Encode the structural filters of many vertices in parallel
+     * @param rows Entity rows to encode
+     * @param numHashes Hash functions of the filters, only used for their construction
+     * @return Row k holds the filter of rows[k]
+     */
+    BitMatrix encodeRows(const std::vector<uint32_t> &rows, const EntityTable &entities, const CsrGraph &graph,
+                         uint8_t numHashes) const {
+        BitMatrix filters(rows.size(), filterSize);
+        parallelFor(0, rows.size(), 1024, [&](std::size_t begin, std::size_t end) {
+            BloomFilter filter(filterSize, numHashes);
+            //One visited array per thread rather than per chunk
+            static thread_local Scratch scratch;
+            for (std::size_t k = begin; k < end; k++) {
+                filter.reset();
+                encode(rows[k], entities, graph, filter, scratch);
+                std::copy(filter.words(), filter.words() + filter.numWords(), filters.row(k));
+            }
+        }, threads);
+        return filters;
+    }
+
+    inline std::size_t hops() const { return hopHashes.size(); }
+
+private:
+    inline void visit(uint32_t neighbour, Scratch &scratch) const {
+        if (scratch.visited[neighbour] != scratch.stamp) {
+            scratch.visited[neighbour] = scratch.stamp;
+            scratch.next.push_back(neighbour);
+        }
+    }
+
+    inline uint64_t mix(uint64_t entity, uint64_t from, uint64_t hop) const {
+        //splitmix64 finalizer over the seed and the sampling site
+        uint64_t z = seed ^ (entity * 0x9e3779b97f4a7c15ULL) ^ (from * 0xc2b2ae3d27d4eb4fULL) ^ (hop << 56);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    /**
+     * Uniform sample of degreeCap distinct indices out of [0, count) by Floyd's algorithm
+     */
+    void sampleIndices(std::size_t count, uint64_t state, std::vector<uint32_t> &sample) const {
+        sample.clear();
+        for (std::size_t j = count - degreeCap; j < count; j++) {
+            state += 0x9e3779b97f4a7c15ULL;
+            uint64_t z = state;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            uint32_t pick = reduceRange(z ^ (z >> 31), j + 1);
+            bool taken = std::find(sample.begin(), sample.end(), pick) != sample.end();
+            sample.push_back(taken ? (uint32_t) j : pick);
+        }
+    }
+
+    uint64_t filterSize;
+    std::vector<uint8_t> hopHashes;
+    uint32_t degreeCap;
+    uint64_t seed;
+    unsigned threads;
+};
+
+#endif //ENTITYRESOLUTION_STRUCTURALENCODER_H
@@ -0,0 +1,233 @@
+//
+// Created by root on 10/16/26.
+//
+
+#ifndef ENTITYRESOLUTION_TRACE_H
+#define ENTITYRESOLUTION_TRACE_H
+
+/*
+ * Stage level tracing, compiled in only with -DENTITYRESOLUTION_TRACE:
+ *
+ *   TRACE_SCOPE("encode");             times the enclosing block as one event
+ *   TRACE_COUNT("records", n);         adds n to a counter of the innermost open scope of this thread
+ *   TRACE_REPORT("trace.json");        writes a Chrome trace (chrome://tracing, Perfetto) and prints a summary
+ *
+ * Without the flag the macros expand to nothing and their arguments are not evaluated, so instrumented code
+ * compiles to what it was before. With it a scope costs two clock reads and one locked append when it closes,
+ * so scopes belong around stages and chunks of work, never around single records; counters are meant to be
+ * added once per scope from totals the code already keeps.
+ */
+
+#ifdef ENTITYRESOLUTION_TRACE
+
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Collects the closed scopes of all threads
+ */
+class Tracer {
+public:
+    struct Event {
+        const char *name;
+        uint32_t thread;
+        uint64_t start;
+        uint64_t duration;
+        std::vector<std::pair<const char *, uint64_t>> counters;
+    };
+
+    static Tracer &instance() {
+        static Tracer tracer;
+        return tracer;
+    }
+
+    /**
+     * Nanoseconds since the tracer was created
+     */
+    inline uint64_t now() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    /**
+     * Small sequential number of the calling thread, used as its trace ID
+     */
+    inline uint32_t threadId() {
+        static thread_local uint32_t id = nextThread++;
+        return id;
+    }
+
+    void record(Event &&event) {
+        std::lock_guard<std::mutex> lock(mutex);
+        events.push_back(std::move(event));
+    }
+
+    /**
+     * Write all events as Chrome trace-event JSON, complete ("X") events with their counters as args
+     * @return false if the file could not be written
+     */
+    bool writeChromeTrace(const std::string &path) {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::ofstream out(path);
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        for (std::size_t e = 0; e < events.size(); e++) {
+            const Event &event = events[e];
+            char times[96];
+            std::snprintf(times, sizeof(times), "\"ts\":%.3f,\"dur\":%.3f", event.start / 1e3, event.duration / 1e3);
+            out << (e == 0 ? "" : ",") << "\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+                << event.thread << "," << times << ",\"args\":{";
+            for (std::size_t c = 0; c < event.counters.size(); c++) {
+                out << (c == 0 ? "" : ",") << "\"" << event.counters[c].first << "\":" << event.counters[c].second;
+            }
+            out << "}}";
+        }
+        out << "\n]}\n";
+        return (bool) out;
+    }
+
+    /**
+     * Per scope name: calls, total, mean and longest time, then every counter with its rate over the total time
+     */
+    void printSummary(std::ostream &out) {
+        struct Row {
+            const char *name;
+            uint64_t calls = 0;
+            uint64_t total = 0;
+            uint64_t longest = 0;
+            std::vector<std::pair<const char *, uint64_t>> counters;
+        };
+        std::vector<Row> rows;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const Event &event: events) {
+                Row *row = nullptr;
+                for (Row &existing: rows) {
+                    if (std::strcmp(existing.name, event.name) == 0) {
+                        row = &existing;
+                        break;
+                    }
+                }
+                if (row == nullptr) {
+                    rows.emplace_back();
+                    row = &rows.back();
+                    row->name = event.name;
+                }
+                row->calls++;
+                row->total += event.duration;
+                row->longest = std::max(row->longest, event.duration);
+                for (const auto &counter: event.counters) {
+                    addCounter(row->counters, counter.first, counter.second);
+                }
+            }
+        }
+
+        char line[160];
+        std::snprintf(line, sizeof(line), "%-28s %8s %12s %12s %12s  %s", "scope", "calls", "total ms", "mean ms",
+                      "max ms", "counters");
+        out << line << std::endl;
+        for (const Row &row: rows) {
+            std::snprintf(line, sizeof(line), "%-28s %8llu %12.3f %12.3f %12.3f ", row.name,
+                          (unsigned long long) row.calls, row.total / 1e6, row.total / 1e6 / row.calls,
+                          row.longest / 1e6);
+            out << line;
+            for (const auto &counter: row.counters) {
+                std::snprintf(line, sizeof(line), " %s=%llu (%.3g/s)", counter.first,
+                              (unsigned long long) counter.second,
+                              row.total == 0 ? 0.0 : counter.second / (row.total / 1e9));
+                out << line;
+            }
+            out << std::endl;
+        }
+    }
+
+    static void addCounter(std::vector<std::pair<const char *, uint64_t>> &counters, const char *name,
+                           uint64_t value) {
+        for (auto &counter: counters) {
+            if (std::strcmp(counter.first, name) == 0) {
+                counter.second += value;
+                return;
+            }
+        }
+        counters.emplace_back(name, value);
+    }
+
+private:
+    Tracer() : epoch(std::chrono::steady_clock::now()), nextThread(0) {}
+
+    std::chrono::steady_clock::time_point epoch;
+    std::atomic<uint32_t> nextThread;
+    std::mutex mutex;
+    std::vector<Tracer::Event> events;
+};
+
+/**
+ * Times its own lifetime and collects the counters added while it is the innermost scope of its thread
+ */
+class TraceScope {
+public:
+    explicit TraceScope(const char *name) : parent(current()) {
+        Tracer &tracer = Tracer::instance();
+        event.name = name;
+        event.thread = tracer.threadId();
+        event.start = tracer.now();
+        current() = this;
+    }
+
+    TraceScope(const TraceScope &) = delete;
+
+    TraceScope &operator=(const TraceScope &) = delete;
+
+    ~TraceScope() {
+        Tracer &tracer = Tracer::instance();
+        event.duration = tracer.now() - event.start;
+        current() = parent;
+        tracer.record(std::move(event));
+    }
+
+    /**
+     * Add to a counter of the innermost open scope of the calling thread, dropped if there is none
+     */
+    static void count(const char *name, uint64_t value) {
+        if (current() != nullptr) {
+            Tracer::addCounter(current()->event.counters, name, value);
+        }
+    }
+
+private:
+    static TraceScope *&current() {
+        static thread_local TraceScope *scope = nullptr;
+        return scope;
+    }
+
+    TraceScope *parent;
+    Tracer::Event event;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_COUNT(name, value) TraceScope::count(name, (uint64_t) (value))
+#define TRACE_REPORT(path) \
+    do { \
+        Tracer::instance().writeChromeTrace(path); \
+        Tracer::instance().printSummary(std::cout); \
+    } while (0)
+
+#else
+
+#define TRACE_SCOPE(name) do {} while (0)
+#define TRACE_COUNT(name, value) do {} while (0)
+#define TRACE_REPORT(path) do {} while (0)
+
+#endif //ENTITYRESOLUTION_TRACE
+
+#endif //ENTITYRESOLUTION_TRACE_H
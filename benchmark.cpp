@@ -0,0 +1,940 @@
+#include <array>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <set>
+#include <sstream>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "bh.h"
+#include "MinHash.hpp"
+#include "BucketMerge.h"
+#include "FilterComparator.h"
+#include "LinkTable.h"
+#include "EntityGraph.h"
+#include "ClusterPartitioner.h"
+#include "IncrementalResolver.h"
+#include "Kmeans.h"
+#include "Pipeline.h"
+
+using namespace std;
+
+/**
+ * Generate random lower-case strings resembling attribute values
+ * @param count Number of strings
+ * @param minLen Minimum string length
+ * @param maxLen Maximum string length
+ * @return Vector of strings
+ */
+vector<string> randomStrings(size_t count, size_t minLen, size_t maxLen) {
+    mt19937_64 rng(42);
+    uniform_int_distribution<size_t> lengths(minLen, maxLen);
+    uniform_int_distribution<int> letters('a', 'z');
+    vector<string> strings(count);
+    for (auto &str: strings) {
+        str.resize(lengths(rng));
+        for (auto &c: str) {
+            c = (char) letters(rng);
+        }
+    }
+    return strings;
+}
+
+double secondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * Bigram insertion as BloomFilter::insert used to do it, with one substr temporary per gram
+ * (kept alive for the hash call so the comparison stays well defined)
+ */
+void legacyInsert(BloomFilter &filter, string &str) {
+    int len = str.length();
+
+    if (len < 2) {
+        char key = str[0];
+        filter.add(&key, 1);
+    } else {
+        for (int i = 0; i < len - 2; i++) {
+            string gram = str.substr(i, i + 2);
+            filter.add(gram.c_str(), 2);
+        }
+    }
+}
+
+/**
+ * Measure grams/second of the substr based tokenizer against the zero-copy QGramTokenizer
+ */
+void benchmarkQGrams() {
+    vector<string> attributes = randomStrings(1000000, 4, 40);
+    //The old loop stopped one gram short, count each side's own work
+    size_t legacyGrams = 0;
+    size_t grams = 0;
+    for (auto &attr: attributes) {
+        legacyGrams += attr.size() - 2;
+        grams += attr.size() - 1;
+    }
+
+    BloomFilter filter(1024, 4);
+    auto start = chrono::steady_clock::now();
+    for (auto &attr: attributes) {
+        legacyInsert(filter, attr);
+    }
+    double before = secondsSince(start);
+
+    filter.reset();
+    start = chrono::steady_clock::now();
+    for (auto &attr: attributes) {
+        filter.insert(attr);
+    }
+    double after = secondsSince(start);
+
+    cout << "q-gram insert (q=2, " << attributes.size() << " strings)" << endl;
+    cout << "  substr:    " << legacyGrams / before / 1e6 << " Mgrams/s" << endl;
+    cout << "  tokenizer: " << grams / after / 1e6 << " Mgrams/s" << endl;
+}
+
+/**
+ * Measure per-key MurmurHash3 against the batched short key path, and modulo against range reduction
+ * for deriving filter positions
+ */
+void benchmarkHashing() {
+    vector<string> keys = randomStrings(4000000, 2, 12);
+    vector<const void *> keyPtrs(keys.size());
+    vector<int> keyLens(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+        keyPtrs[i] = keys[i].data();
+        keyLens[i] = keys[i].size();
+    }
+    vector<uint64_t> hashes(2 * keys.size());
+
+    auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < keys.size(); i++) {
+        MurmurHash3_x64_128(keyPtrs[i], keyLens[i], 0, hashes.data() + 2 * i);
+    }
+    double single = secondsSince(start);
+
+    start = chrono::steady_clock::now();
+    MurmurHash3_x64_128_batch(keyPtrs.data(), keyLens.data(), keys.size(), 0, hashes.data());
+    double batched = secondsSince(start);
+
+    //Positions for a non power of two length so the range reduction takes the multiply-shift branch
+    volatile uint64_t filterSizeInput = 1000;
+    uint64_t filterSize = filterSizeInput;
+    uint64_t checksum = 0;
+    start = chrono::steady_clock::now();
+    for (size_t i = 0; i < keys.size(); i++) {
+        for (uint64_t n = 0; n < 4; n++) {
+            checksum += (hashes[2 * i] + n * hashes[2 * i + 1]) % filterSize;
+        }
+    }
+    double modulo = secondsSince(start);
+
+    start = chrono::steady_clock::now();
+    for (size_t i = 0; i < keys.size(); i++) {
+        for (uint64_t n = 0; n < 4; n++) {
+            checksum += reduceRange(hashes[2 * i] + n * hashes[2 * i + 1], filterSize);
+        }
+    }
+    double reduced = secondsSince(start);
+
+    cout << "hashing (" << keys.size() << " keys of 2-12 bytes)" << endl;
+    cout << "  single:  " << keys.size() / single / 1e6 << " Mkeys/s" << endl;
+    cout << "  batched: " << keys.size() / batched / 1e6 << " Mkeys/s" << endl;
+    cout << "  positions with %:           " << 4 * keys.size() / modulo / 1e6 << " M/s" << endl;
+    cout << "  positions with reduceRange: " << 4 * keys.size() / reduced / 1e6 << " M/s"
+         << " (checksum " << (checksum & 0xff) << ")" << endl;
+}
+
+/**
+ * Random set of the given size over filterLen bits, packed
+ */
+vector<uint64_t> randomSet(mt19937_64 &rng, uint16_t filterLen, size_t size) {
+    vector<uint16_t> bits(filterLen);
+    for (uint16_t b = 0; b < filterLen; b++) {
+        bits[b] = b;
+    }
+    shuffle(bits.begin(), bits.end(), rng);
+    vector<uint64_t> mask((filterLen + 63) / 64, 0);
+    for (size_t i = 0; i < size; i++) {
+        mask[bits[i] >> 6] |= uint64_t(1) << (bits[i] & 63);
+    }
+    return mask;
+}
+
+/**
+ * Copy of a set with the given number of its bits moved to bits outside it, so both sets keep their size
+ */
+vector<uint64_t> perturbSet(mt19937_64 &rng, const vector<uint64_t> &mask, uint16_t filterLen, size_t moves) {
+    vector<uint16_t> inside;
+    vector<uint16_t> outside;
+    for (uint16_t b = 0; b < filterLen; b++) {
+        ((mask[b >> 6] >> (b & 63)) & 1 ? inside : outside).push_back(b);
+    }
+    shuffle(inside.begin(), inside.end(), rng);
+    shuffle(outside.begin(), outside.end(), rng);
+    vector<uint64_t> moved = mask;
+    for (size_t i = 0; i < moves; i++) {
+        moved[inside[i] >> 6] &= ~(uint64_t(1) << (inside[i] & 63));
+        moved[outside[i] >> 6] |= uint64_t(1) << (outside[i] & 63);
+    }
+    return moved;
+}
+
+/**
+ * Binary points around k random prototypes, each bit of a prototype flipped with probability 1/8, one point
+ * per column
+ */
+arma::Mat<float> clusteredPoints(mt19937_64 &rng, size_t n, size_t dims, uint16_t k) {
+    vector<vector<uint8_t>> prototypes(k, vector<uint8_t>(dims));
+    for (auto &prototype: prototypes) {
+        for (auto &bit: prototype) {
+            bit = rng() % 10 < 3;
+        }
+    }
+    arma::Mat<float> points(dims, n);
+    for (size_t i = 0; i < n; i++) {
+        const vector<uint8_t> &prototype = prototypes[rng() % k];
+        float *column = points.colptr(i);
+        for (size_t d = 0; d < dims; d++) {
+            column[d] = prototype[d] ^ (rng() % 8 == 0);
+        }
+    }
+    return points;
+}
+
+/**
+ * Kmeans::apply as it used to be: one column at a time, the squared distance to every centroid summed in the
+ * element type, the last centroid winning a tie
+ */
+arma::Mat<uint16_t> legacyKmeansApply(const arma::Mat<float> &data, const arma::Mat<float> &means) {
+    arma::Mat<uint16_t> predictions(1, data.n_cols);
+    for (size_t i = 0; i < data.n_cols; i++) {
+        arma::Col<float> datapoint = data.col(i);
+        double best_dist = arma::Datum<double>::inf;
+        uint16_t best_g = 0;
+        for (uint16_t g = 0; g < means.n_cols; ++g) {
+            const double tmp_dist = arma::accu(arma::square(datapoint - means.col(g)));
+            if (tmp_dist <= best_dist) {
+                best_dist = tmp_dist;
+                best_g = g;
+            }
+        }
+        predictions(i) = best_g;
+    }
+    return predictions;
+}
+
+/**
+ * Measure the tiled Kmeans::apply against the per-column loop it replaced and count the points the two assign
+ * differently, on fitted (fractional) centroids of binary points
+ */
+void benchmarkKmeansApply() {
+    const size_t n = 100000;
+    const size_t dims = 256;
+    const uint16_t k = 16;
+    mt19937_64 rng(13);
+    arma::Mat<float> data = clusteredPoints(rng, n, dims, k);
+    Kmeans<float> model(k);
+    model.fit(data, 5);
+    arma::Mat<float> means = model.getMeans();
+
+    //Second half of the centroids copies the first, one coordinate nudged by a few ulps, so every point has a
+    //near tie that only the rounding of the distance sums decides
+    arma::Mat<float> nearTies = means;
+    for (uint16_t g = k / 2; g < k; g++) {
+        float *centroid = nearTies.colptr(g);
+        copy(means.colptr(g - k / 2), means.colptr(g - k / 2) + dims, centroid);
+        float &nudged = centroid[rng() % dims];
+        for (int ulp = rng() % 4; ulp > 0; ulp--) {
+            nudged = nextafter(nudged, 1.0f);
+        }
+    }
+    Kmeans<float> tied(k);
+    auto noPoints = [](const vector<size_t> &, arma::Mat<float> &) {};
+    tied.fitMiniBatch(noPoints, n, nearTies, 1, 0);
+
+    cout << "kmeans apply (" << n << " points, " << dims << " dimensions, " << k << " centroids)" << endl;
+    for (auto *run: {&model, &tied}) {
+        arma::Mat<float> centroids = run->getMeans();
+        auto start = chrono::steady_clock::now();
+        arma::Mat<uint16_t> legacy = legacyKmeansApply(data, centroids);
+        double perColumn = secondsSince(start);
+        start = chrono::steady_clock::now();
+        arma::Mat<uint16_t> tiled = run->apply(data);
+        double tiles = secondsSince(start);
+
+        size_t mismatches = 0;
+        for (size_t i = 0; i < n; i++) {
+            mismatches += legacy(i) != tiled(i);
+        }
+        cout << "  " << (run == &model ? "fitted centroids" : "near tied centroids") << ": per column "
+             << perColumn * 1e3 << " ms, tiled " << tiles * 1e3 << " ms, " << mismatches
+             << " points assigned differently" << endl;
+    }
+}
+
+/**
+ * Mean squared distance of every point to its nearest centroid
+ */
+double meanSquaredError(Kmeans<float> &model, arma::Mat<float> &data) {
+    arma::Mat<uint16_t> predictions = model.apply(data);
+    arma::Mat<float> means = model.getMeans();
+    double error = 0;
+    for (size_t i = 0; i < data.n_cols; i++) {
+        const float *point = data.colptr(i);
+        const float *centroid = means.colptr(predictions(i));
+        for (size_t d = 0; d < data.n_rows; d++) {
+            error += (point[d] - centroid[d]) * (point[d] - centroid[d]);
+        }
+    }
+    return error / data.n_cols;
+}
+
+/**
+ * Measure mini-batch k-means streaming packed filters against a full fit on the dense matrix: time and the
+ * mean squared error both end up with. Points are stored grouped by prototype, the order in which a sorted
+ * filter file would hold them, so batches that were not sampled uniformly would only see a few clusters.
+ */
+void benchmarkMiniBatch() {
+    const size_t n = 200000;
+    const size_t dims = 256;
+    const uint16_t k = 16;
+    mt19937_64 rng(17);
+    arma::Mat<float> data = clusteredPoints(rng, n, dims, k);
+    //Group the points by their nearest prototype through one full assignment pass
+    Kmeans<float> reference(k);
+    reference.fit(data, 10);
+    arma::Mat<uint16_t> groups = reference.apply(data);
+    vector<size_t> order(n);
+    iota(order.begin(), order.end(), 0);
+    stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return groups(a) < groups(b); });
+    arma::Mat<float> sorted(dims, n);
+    BitMatrix filters(n, dims);
+    for (size_t i = 0; i < n; i++) {
+        const float *point = data.colptr(order[i]);
+        copy(point, point + dims, sorted.colptr(i));
+        for (size_t d = 0; d < dims; d++) {
+            if (point[d] != 0) {
+                filters.row(i)[d >> 6] |= uint64_t(1) << (d & 63);
+            }
+        }
+    }
+
+    Kmeans<float> full(k);
+    auto start = chrono::steady_clock::now();
+    full.fit(sorted, 10);
+    double fullSeconds = secondsSince(start);
+
+    Kmeans<float> miniBatch(k);
+    start = chrono::steady_clock::now();
+    miniBatch.fitMiniBatch(filterColumns<float>(filters.view()), n, 2048, 100);
+    double miniBatchSeconds = secondsSince(start);
+
+    cout << "kmeans fit (" << n << " points, " << dims << " dimensions, " << k << " centroids)" << endl;
+    cout << "  full, 10 iterations:   " << fullSeconds * 1e3 << " ms, mean squared error "
+         << meanSquaredError(full, sorted) << endl;
+    cout << "  mini-batch, 100 x 2048: " << miniBatchSeconds * 1e3 << " ms, mean squared error "
+         << meanSquaredError(miniBatch, sorted) << endl;
+}
+
+/**
+ * Signature as generateCRV used to compute it: entry i is index_max of the mask permuted by permutation i,
+ * so the first permuted position holding a set bit, or 0 when there is none
+ */
+vector<short> legacySignature(MinHash &minHash, const vector<uint64_t> &mask, uint16_t filterLen) {
+    vector<short> signature(minHash.getSize(), 0);
+    for (uint8_t i = 0; i < minHash.getSize(); i++) {
+        for (uint16_t p = 0; p < filterLen; p++) {
+            string key = to_string(p);
+            array<uint64_t, 2> hashValue = minHash.hash(key.data(), key.size());
+            uint16_t bit = minHash.nthHash(i, hashValue[0], hashValue[1], filterLen);
+            if ((mask[bit >> 6] >> (bit & 63)) & 1) {
+                signature[i] = p;
+                break;
+            }
+        }
+    }
+    return signature;
+}
+
+/**
+ * Compare the signature modes: signatures/second, error of the Jaccard estimate and the LSH candidate rate
+ * (bands of rows, a pair is a candidate when any band matches) for pairs at a range of true similarities
+ */
+void benchmarkMinHash() {
+    const uint16_t filterLen = 256;
+    const uint8_t minhashSize = 100;
+    const size_t setSize = 128;
+    const int pairs = 2000;
+    const int bands = 20;
+    const int rows = 5;
+
+    struct Setup {
+        const char *name;
+        MinHashMode mode;
+        uint8_t bBits;
+    };
+    vector<Setup> setups = {{"permutations", MinHashMode::Permutations, 0},
+                            {"one permutation", MinHashMode::OnePermutation, 0},
+                            {"one permutation, b=4", MinHashMode::OnePermutation, 4}};
+
+    mt19937_64 rng(7);
+    vector<vector<uint64_t>> sets(10000);
+    for (auto &set: sets) {
+        set = randomSet(rng, filterLen, setSize);
+    }
+
+    cout << "minhash (" << (int) minhashSize << " values, " << filterLen << " bits, " << bands << "x" << rows
+         << " bands)" << endl;
+    for (auto &setup: setups) {
+        auto start = chrono::steady_clock::now();
+        MinHash minHash(minhashSize, filterLen, setup.mode, setup.bBits);
+        double build = secondsSince(start);
+
+        vector<short> signature(minhashSize);
+        uint64_t checksum = 0;
+        start = chrono::steady_clock::now();
+        for (auto &set: sets) {
+            minHash.signature(set.data(), signature.data());
+            checksum += signature[0];
+        }
+        double signing = secondsSince(start);
+        cout << "  " << setup.name << ": build " << build * 1e3 << " ms, " << sets.size() / signing / 1e3
+             << " Ksignatures/s (checksum " << (checksum & 0xff) << ")" << endl;
+
+        //Full permutations have to reproduce the old signatures, sparse sets included where some permutation
+        //reaches no set bit
+        if (setup.mode == MinHashMode::Permutations) {
+            size_t mismatches = 0;
+            for (size_t size: {(size_t) 0, (size_t) 1, (size_t) 2, setSize}) {
+                for (int s = 0; s < 20; s++) {
+                    vector<uint64_t> set = randomSet(rng, filterLen, size);
+                    minHash.signature(set.data(), signature.data());
+                    mismatches += legacySignature(minHash, set, filterLen) != signature;
+                }
+            }
+            cout << "    signatures differing from the old index_max loop: " << mismatches << " of 80" << endl;
+        }
+
+        //Chance collision of b-bit values is corrected out of the estimate
+        double chance = setup.bBits == 0 ? 0.0 : 1.0 / (1 << setup.bBits);
+        vector<short> first(minhashSize);
+        vector<short> second(minhashSize);
+        for (size_t moves: {13, 32, 64}) {
+            double jaccard = (double) (setSize - moves) / (setSize + moves);
+            double error = 0;
+            int candidates = 0;
+            for (int p = 0; p < pairs; p++) {
+                vector<uint64_t> a = randomSet(rng, filterLen, setSize);
+                vector<uint64_t> b = perturbSet(rng, a, filterLen, moves);
+                minHash.signature(a.data(), first.data());
+                minHash.signature(b.data(), second.data());
+                int equal = 0;
+                bool candidate = false;
+                for (int band = 0; band < bands; band++) {
+                    bool bandEqual = true;
+                    for (int r = band * rows; r < (band + 1) * rows; r++) {
+                        equal += first[r] == second[r];
+                        bandEqual = bandEqual && first[r] == second[r];
+                    }
+                    candidate = candidate || bandEqual;
+                }
+                double estimate = ((double) equal / minhashSize - chance) / (1 - chance);
+                error += fabs(estimate - jaccard);
+                candidates += candidate;
+            }
+            cout << "    J=" << jaccard << ": mean |error| " << error / pairs << ", candidate rate "
+                 << (double) candidates / pairs << endl;
+        }
+    }
+}
+
+/**
+ * Bucket merging as getSimilarClusters used to do it, on nested maps and sets of names (with the by-value
+ * copies removed so only the data structure is measured)
+ */
+size_t legacyBucketMerge(const map<string, map<unsigned long, set<string>>> &allBuckets, size_t minParties) {
+    map<unsigned long, map<string, set<string>>> combinedBuckets;
+    for (const auto &orgBuckets: allBuckets) {
+        for (const auto &bucket: orgBuckets.second) {
+            combinedBuckets[bucket.first][orgBuckets.first].insert(bucket.second.begin(), bucket.second.end());
+        }
+    }
+    size_t kept = 0;
+    for (const auto &bucket: combinedBuckets) {
+        kept += bucket.second.size() >= minParties;
+    }
+    return kept;
+}
+
+/**
+ * Measure the coordinator bucket merge: nested maps of names against the interned sort-merge, on entries
+ * spread over 8 parties
+ */
+void benchmarkBucketMerge() {
+    const uint32_t parties = 8;
+    const uint32_t minParties = 3;
+    for (size_t entries: {1000000, 10000000}) {
+        mt19937_64 rng(11);
+        //Few enough distinct buckets that many of them are shared by several parties
+        uniform_int_distribution<uint64_t> buckets(0, entries / 4);
+        uniform_int_distribution<uint32_t> clusters(0, 9999);
+
+        vector<BucketEntry> generated(entries);
+        for (size_t i = 0; i < entries; i++) {
+            generated[i] = {buckets(rng) * 0x9e3779b97f4a7c15ULL, (uint32_t) (i % parties), clusters(rng)};
+        }
+
+        auto start = chrono::steady_clock::now();
+        BucketMerger merger;
+        merger.reserve(entries);
+        for (auto &entry: generated) {
+            merger.add(entry.bucket, entry.party, entry.cluster);
+        }
+        MergedBuckets merged = merger.merge(minParties);
+        double sorted = secondsSince(start);
+        cout << "bucket merge (" << entries << " entries, " << parties << " parties, >= " << minParties << ")"
+             << endl;
+        cout << "  sort-merge:  " << sorted * 1e3 << " ms, " << merged.size() << " buckets kept" << endl;
+
+        //Whole table kept, quorum applied afterwards on the party masks
+        merger.clear();
+        for (auto &entry: generated) {
+            merger.add(entry.bucket, entry.party, entry.cluster);
+        }
+        MergedBuckets all = merger.merge(1);
+        for (uint32_t quorum: {3, 5}) {
+            start = chrono::steady_clock::now();
+            size_t kept = all.withQuorum(quorum).size();
+            cout << "  quorum " << quorum << " of " << all.size() << " buckets: " << secondsSince(start) * 1e3
+                 << " ms, " << kept << " kept" << endl;
+        }
+
+        if (entries > 1000000) {
+            continue;
+        }
+        map<string, map<unsigned long, set<string>>> allBuckets;
+        for (auto &entry: generated) {
+            allBuckets["P" + to_string(entry.party)][entry.bucket].insert("C" + to_string(entry.cluster));
+        }
+        start = chrono::steady_clock::now();
+        size_t kept = legacyBucketMerge(allBuckets, minParties);
+        double nested = secondsSince(start);
+        cout << "  nested maps: " << nested * 1e3 << " ms, " << kept << " buckets kept" << endl;
+    }
+}
+
+/**
+ * Measure comparisons/second of the blocked comparator against a serial pair by pair loop that counts both
+ * filters for every comparison, on random 256 bit filters
+ */
+void benchmarkComparator() {
+    const size_t clusters = 16;
+    const size_t filtersPerCluster = 1000;
+    const size_t bits = 256;
+    mt19937_64 rng(5);
+    vector<BitMatrix> self;
+    vector<BitMatrix> other;
+    vector<BitMatrixView> selfViews;
+    vector<BitMatrixView> otherViews;
+    for (size_t c = 0; c < clusters; c++) {
+        for (auto *side: {&self, &other}) {
+            BitMatrix filters(filtersPerCluster, bits);
+            for (size_t i = 0; i < filtersPerCluster; i++) {
+                for (size_t w = 0; w < filters.nWords(); w++) {
+                    filters.row(i)[w] = rng() & rng();
+                }
+            }
+            side->push_back(filters);
+        }
+    }
+    for (size_t c = 0; c < clusters; c++) {
+        selfViews.push_back(self[c].view());
+        otherViews.push_back(other[c].view());
+    }
+    vector<ClusterPair> pairs;
+    for (uint32_t c = 0; c < clusters; c++) {
+        pairs.push_back({c, c});
+        pairs.push_back({c, (uint32_t) ((c + 1) % clusters)});
+    }
+
+    auto start = chrono::steady_clock::now();
+    size_t found = 0;
+    for (auto &pair: pairs) {
+        const BitMatrix &a = self[pair.self];
+        const BitMatrix &b = other[pair.other];
+        for (size_t i = 0; i < a.nRows(); i++) {
+            float maxCoeff = -1;
+            for (size_t j = 0; j < b.nRows(); j++) {
+                maxCoeff = max(maxCoeff, diceCoefficient(a.row(i), b.row(j), a.nWords()));
+            }
+            found += maxCoeff > 0.5f;
+        }
+    }
+    double serial = secondsSince(start);
+    uint64_t comparisons = pairs.size() * filtersPerCluster * filtersPerCluster;
+
+    FilterComparator comparator(0.5f);
+    size_t matches = comparator.compare(selfViews, otherViews, pairs).size();
+
+    cout << "filter comparison (" << pairs.size() << " cluster pairs of " << filtersPerCluster << " x "
+         << filtersPerCluster << " filters)" << endl;
+    cout << "  pair by pair: " << comparisons / serial / 1e6 << " M comparisons/s (" << found << " matches)"
+         << endl;
+    cout << "  comparator:   " << comparator.comparisonsPerSecond() / 1e6 << " M comparisons/s (" << matches
+         << " matches)" << endl;
+}
+
+/**
+ * Measure the ring join of pairwise links across 3 parties: string keyed maps as synchronizeCommonEntities used
+ * to hold them against dense link tables
+ */
+void benchmarkLinkJoin() {
+    const size_t parties = 3;
+    for (size_t links: {1000000, 20000000}) {
+        mt19937 rng(9);
+        //Party p + 1 holds the common entities of party p in a shuffled order
+        vector<vector<uint32_t>> order(parties, vector<uint32_t>(links));
+        for (auto &ids: order) {
+            iota(ids.begin(), ids.end(), 0);
+            shuffle(ids.begin(), ids.end(), rng);
+        }
+        vector<LinkTable> ring(parties, LinkTable(links));
+        for (size_t p = 0; p < parties; p++) {
+            for (size_t i = 0; i < links; i++) {
+                ring[p].link(order[p][i], order[(p + 1) % parties][i]);
+            }
+        }
+
+        auto start = chrono::steady_clock::now();
+        vector<const LinkTable *> chain = {&ring[0], &ring[1], &ring[2]};
+        size_t groups = joinChain(chain, true)[0].size();
+        double dense = secondsSince(start);
+        cout << "ring join (" << parties << " parties, " << links << " links per pair)" << endl;
+        cout << "  link tables: " << dense * 1e3 << " ms, " << groups << " common entities" << endl;
+
+        if (links > 1000000) {
+            continue;
+        }
+        vector<map<string, string>> stringRing(parties);
+        for (size_t p = 0; p < parties; p++) {
+            for (size_t i = 0; i < links; i++) {
+                stringRing[p][to_string(order[p][i])] = to_string(order[(p + 1) % parties][i]);
+            }
+        }
+        start = chrono::steady_clock::now();
+        vector<string> ids;
+        for (auto &link: stringRing[0]) {
+            ids.push_back(link.first);
+        }
+        for (size_t p = 0; p < parties; p++) {
+            vector<string> next;
+            for (auto &id: ids) {
+                auto found = stringRing[p].find(id);
+                if (found != stringRing[p].end()) {
+                    next.push_back(found->second);
+                }
+            }
+            ids.swap(next);
+        }
+        double strings = secondsSince(start);
+        cout << "  string maps: " << strings * 1e3 << " ms, " << ids.size() << " common entities" << endl;
+    }
+}
+
+/**
+ * Measure load rates of the entity and edge files: getline, split and stoi into maps as main used to read them
+ * against the mapped parallel parser
+ */
+void benchmarkIngestion() {
+    const size_t entities = 1000000;
+    const size_t edges = 10000000;
+    const string entityPath = "benchmark_entities.txt";
+    const string edgePath = "benchmark_edges.txt";
+    {
+        vector<string> words = randomStrings(entities * 3, 3, 10);
+        ofstream entityFile(entityPath);
+        for (size_t i = 0; i < entities; i++) {
+            entityFile << i << ' ' << words[3 * i] << ' ' << words[3 * i + 1] << ' ' << words[3 * i + 2] << '\n';
+        }
+        mt19937_64 rng(3);
+        ofstream edgeFile(edgePath);
+        for (size_t e = 0; e < edges; e++) {
+            edgeFile << rng() % entities << ' ' << rng() % entities << '\n';
+        }
+    }
+    MappedFile entityBytes;
+    MappedFile edgeBytes;
+    entityBytes.open(entityPath);
+    edgeBytes.open(edgePath);
+    double megabytes = (entityBytes.size() + edgeBytes.size()) / 1e6;
+
+    auto start = chrono::steady_clock::now();
+    map<int, vector<string>> entityData;
+    map<int, vector<int>> neighborhoodData;
+    ifstream entityFile(entityPath);
+    string line;
+    while (getline(entityFile, line)) {
+        size_t space = line.find(' ');
+        vector<string> tokens;
+        istringstream tokenStream(line.substr(space + 1));
+        for (string token; getline(tokenStream, token, ' ');) {
+            tokens.push_back(token);
+        }
+        entityData[stoi(line.substr(0, space))] = tokens;
+    }
+    ifstream edgeFile(edgePath);
+    while (getline(edgeFile, line)) {
+        size_t space = line.find(' ');
+        neighborhoodData[stoi(line.substr(0, space))].emplace_back(stoi(line.substr(space + 1)));
+    }
+    double legacy = secondsSince(start);
+
+    start = chrono::steady_clock::now();
+    EntityTable table;
+    CsrGraph graph;
+    table.load(entityPath);
+    graph.load(edgePath, table);
+    double mapped = secondsSince(start);
+
+    cout << "ingestion (" << entities << " entities, " << edges << " edges, " << megabytes << " MB)" << endl;
+    cout << "  getline/maps:  " << megabytes / legacy << " MB/s (" << entityData.size() << " entities)" << endl;
+    cout << "  mapped/CSR:    " << megabytes / mapped << " MB/s (" << table.size() << " entities, "
+         << graph.edgeCount() << " edges)" << endl;
+    remove(entityPath.c_str());
+    remove(edgePath.c_str());
+}
+
+void legacySeperateClusters(const FilterStore &filters, const vector<uint16_t> &pred, int clusterCount,
+                            const string &outfilePrefix) {
+    for (int i = 0; i < clusterCount; i++) {
+        FilterStoreWriter writer;
+        writer.open(outfilePrefix + to_string(i) + ".bin", filters.nBits());
+        for (size_t index = 0; index < pred.size(); index++) {
+            if (pred[index] == i) {
+                writer.append(filters.id(index), filters.row(index));
+            }
+        }
+        writer.close();
+    }
+}
+
+void benchmarkPartition() {
+    const size_t filters = 2000000;
+    const size_t bits = 256;
+    const int clusterCount = 16;
+    mt19937_64 rng(9);
+    BitMatrix attr(filters, bits);
+    BitMatrix structural(filters, bits);
+    vector<int64_t> ids(filters);
+    vector<uint16_t> pred(filters);
+    for (size_t i = 0; i < filters; i++) {
+        for (size_t w = 0; w < attr.nWords(); w++) {
+            attr.row(i)[w] = rng();
+            structural.row(i)[w] = rng();
+        }
+        ids[i] = i;
+        pred[i] = rng() % clusterCount;
+    }
+    {
+        FilterStoreWriter attrWriter;
+        FilterStoreWriter structWriter;
+        attrWriter.open("benchmark_attr.bin", bits);
+        structWriter.open("benchmark_struct.bin", bits);
+        attrWriter.append(ids, attr.view());
+        structWriter.append(ids, structural.view());
+    }
+    FilterStore attrStore;
+    FilterStore structStore;
+    attrStore.load("benchmark_attr.bin");
+    structStore.load("benchmark_struct.bin");
+
+    //Legacy: one scan per cluster and filter kind, then every cluster file mapped again for the CRVs
+    auto start = chrono::steady_clock::now();
+    legacySeperateClusters(attrStore, pred, clusterCount, "benchmark_attrcluster");
+    legacySeperateClusters(structStore, pred, clusterCount, "benchmark_structcluster");
+    vector<FilterStore> reloaded(clusterCount);
+    size_t legacyRows = 0;
+    for (int c = 0; c < clusterCount; c++) {
+        reloaded[c].load("benchmark_attrcluster" + to_string(c) + ".bin");
+        legacyRows += reloaded[c].size();
+    }
+    double legacy = secondsSince(start);
+
+    start = chrono::steady_clock::now();
+    ClusterPartitioner partitioner;
+    ClusterPartition partition = partitioner.partition(attrStore.view(), structStore.view(), attrStore.ids(), pred,
+                                                       clusterCount);
+    double scattered = secondsSince(start);
+    partitioner.save(partition, "benchmark_attrcluster", "benchmark_structcluster");
+    double saved = secondsSince(start);
+
+    bool same = true;
+    for (int c = 0; c < clusterCount; c++) {
+        FilterStore written;
+        written.load("benchmark_attrcluster" + to_string(c) + ".bin");
+        same = same && written.size() == reloaded[c].size() && partition.clusterSize(c) == written.size() &&
+               equal(written.ids(), written.ids() + written.size(), partition.clusterIds(c));
+    }
+
+    cout << "cluster partition (" << filters << " filters, " << clusterCount << " clusters, attr + struct)" << endl;
+    cout << "  per cluster scans: " << legacy << " s (" << legacyRows << " rows)" << endl;
+    cout << "  counting sort:     " << scattered << " s in memory, " << saved << " s with files"
+         << (same ? "" : " MISMATCH") << endl;
+    remove("benchmark_attr.bin");
+    remove("benchmark_struct.bin");
+    for (int c = 0; c < clusterCount; c++) {
+        remove(("benchmark_attrcluster" + to_string(c) + ".bin").c_str());
+        remove(("benchmark_structcluster" + to_string(c) + ".bin").c_str());
+    }
+}
+
+void benchmarkIncremental() {
+    const size_t entities = 500000;
+    const size_t edges = 4000000;
+    const size_t changes = entities / 200;
+    mt19937_64 rng(5);
+    vector<string> words = randomStrings(entities * 2, 3, 10);
+    vector<pair<int64_t, int64_t>> edgeList(edges);
+    for (auto &edge: edgeList) {
+        edge = {(int64_t) (rng() % entities), (int64_t) (rng() % entities)};
+    }
+    auto write = [&](string &entityText, string &edgeText) {
+        ostringstream entityStream;
+        ostringstream edgeStream;
+        for (size_t i = 0; i < entities; i++) {
+            entityStream << i << ' ' << words[2 * i] << ' ' << words[2 * i + 1] << '\n';
+        }
+        for (const auto &edge: edgeList) {
+            edgeStream << edge.first << ' ' << edge.second << '\n';
+        }
+        entityText = entityStream.str();
+        edgeText = edgeStream.str();
+    };
+    auto resolver = []() {
+        return IncrementalResolver(FilterEncoder(256, 4, StructuralEncoder(256, {4, 2}, 64)), 8, MinHash(100, 256),
+                                   50, 10, 10);
+    };
+
+    string entityText;
+    string edgeText;
+    write(entityText, edgeText);
+    EntityTable before;
+    CsrGraph beforeGraph;
+    before.parse(entityText.data(), entityText.size());
+    beforeGraph.parse(edgeText.data(), edgeText.size(), before);
+    IncrementalResolver full = resolver();
+    auto start = chrono::steady_clock::now();
+    full.build(before, beforeGraph, "benchmark_state_");
+    double built = secondsSince(start);
+
+    //Modify attributes of some entities and move some edges
+    GraphDelta delta;
+    for (size_t k = 0; k < changes; k++) {
+        size_t entity = rng() % entities;
+        words[2 * entity] = "changed" + to_string(k);
+        delta.entities.push_back(entity);
+        size_t edge = rng() % edges;
+        delta.edges.push_back(edgeList[edge]);
+        edgeList[edge] = {(int64_t) (rng() % entities), (int64_t) (rng() % entities)};
+        delta.edges.push_back(edgeList[edge]);
+    }
+    string changedEntityText;
+    string changedEdgeText;
+    write(changedEntityText, changedEdgeText);
+    EntityTable after;
+    CsrGraph afterGraph;
+    after.parse(changedEntityText.data(), changedEntityText.size());
+    afterGraph.parse(changedEdgeText.data(), changedEdgeText.size(), after);
+    IncrementalResolver incremental = resolver();
+    start = chrono::steady_clock::now();
+    incremental.update(after, afterGraph, delta, "benchmark_state_");
+    double updated = secondsSince(start);
+
+    const UpdateSummary &summary = incremental.lastUpdate();
+    cout << "incremental (" << entities << " entities, " << edges << " edges, " << changes
+         << " attribute and edge changes)" << endl;
+    cout << "  full build:    " << built << " s" << endl;
+    cout << "  update:        " << updated << " s (" << summary.reencoded << " re-encoded, "
+         << summary.changedClusters.size() << " CRVs recomputed)" << endl;
+    for (const char *name: {"attrfilters", "structfilters", "means", "clusters"}) {
+        remove(IncrementalResolver::statePath("benchmark_state_", name, incremental.getGeneration()).c_str());
+    }
+    remove("benchmark_state_state");
+}
+
+void benchmarkPipeline() {
+    const size_t entities = 300000;
+    const size_t edges = 2400000;
+    const string entityPath = "benchmark_entities.txt";
+    const string edgePath = "benchmark_edges.txt";
+    const string checkpointDir = "benchmark_checkpoint";
+    {
+        vector<string> words = randomStrings(entities * 2, 3, 10);
+        ofstream entityFile(entityPath);
+        for (size_t i = 0; i < entities; i++) {
+            entityFile << i << ' ' << words[2 * i] << ' ' << words[2 * i + 1] << '\n';
+        }
+        mt19937_64 rng(11);
+        ofstream edgeFile(edgePath);
+        for (size_t e = 0; e < edges; e++) {
+            edgeFile << rng() % entities << ' ' << rng() % entities << '\n';
+        }
+    }
+    PipelineConfig config;
+    config.entityPath = entityPath;
+    config.edgePath = edgePath;
+    config.clusters = 8;
+
+    auto start = chrono::steady_clock::now();
+    PartyResult inMemory(config.bands, config.rows);
+    PartyPipeline(config).run(inMemory);
+    double memory = secondsSince(start);
+
+    mkdir(checkpointDir.c_str(), 0755);
+    config.checkpointDir = checkpointDir;
+    start = chrono::steady_clock::now();
+    PartyResult checkpointed(config.bands, config.rows);
+    PartyPipeline(config).run(checkpointed);
+    double withCheckpoints = secondsSince(start);
+
+    cout << "party pipeline (" << entities << " entities, " << edges << " edges, " << config.clusters
+         << " clusters)" << endl;
+    cout << "  in memory:        " << memory << " s (" << inMemory.index.bucketCount() << " buckets)" << endl;
+    cout << "  with checkpoints: " << withCheckpoints << " s" << endl;
+    remove(entityPath.c_str());
+    remove(edgePath.c_str());
+    for (const string &file: {string("attrfilters.bin"), string("structfilters.bin"), string("means.bin"),
+                              string("crvs.bin")}) {
+        remove((checkpointDir + "/" + file).c_str());
+    }
+    for (uint16_t c = 0; c < config.clusters; c++) {
+        remove((checkpointDir + "/attrfilterscluster" + to_string(c) + ".bin").c_str());
+        remove((checkpointDir + "/structfilterscluster" + to_string(c) + ".bin").c_str());
+    }
+    rmdir(checkpointDir.c_str());
+}
+
+int main() {
+    benchmarkQGrams();
+    benchmarkHashing();
+    benchmarkKmeansApply();
+    benchmarkMiniBatch();
+    benchmarkMinHash();
+    benchmarkBucketMerge();
+    benchmarkComparator();
+    benchmarkLinkJoin();
+    benchmarkIngestion();
+    benchmarkPartition();
+    benchmarkIncremental();
+    benchmarkPipeline();
+}
@@ -5,42 +5,74 @@
 #ifndef ENTITYRESOLUTION_BH_H
 #define ENTITYRESOLUTION_BH_H
 
-#include <bitset>
+#include <algorithm>
 #include <array>
 #include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
 #include "MurmurHash3.h"
+#include "BitKernels.h"
+#include "QGram.h"
 
+/**
+ * Map a 64-bit hash onto [0, size) without a division: a mask when size is a power of two,
+ * otherwise Lemire's multiply-shift range reduction
+ */
+inline uint64_t reduceRange(uint64_t hash, uint64_t size) {
+    if ((size & (size - 1)) == 0) {
+        return hash & (size - 1);
+    }
+    return (uint64_t) (((unsigned __int128) hash * size) >> 64);
+}
+
+/**
+ * Bloom filter of a runtime chosen length, stored as packed 64-bit words so that set operations and
+ * similarity counts run a word at a time
+ */
 class BloomFilter {
 public:
-    BloomFilter(uint64_t size, uint8_t numHashes)
-            : m_bits(size),
-              m_numHashes(numHashes) {}
-
-    void insert(std::string &str) {
-        int len = str.length();
-
-        if (len < 2) {
-            char key = str[0];
-            add(&key, 1);
-        } else {
-            for (int i = 0; i < len - 2; i++) {
-                const char *key = str.substr(i, i+2).c_str();
-                add(key, 2);
-            }
-        }
-//
-//        for (uint8_t s: str) {
-//            add(&s, 1);
-//        }
+    BloomFilter(uint64_t size, uint8_t numHashes, QGramTokenizer tokenizer = QGramTokenizer())
+            : m_numHashes(numHashes),
+              m_size(size),
+              m_words((size + 63) / 64, 0),
+              m_tokenizer(tokenizer) {}
+
+    /**
+     * Add every q-gram of a string to the filter, hashing straight from the source buffer
+     */
+    void insert(std::string_view str) {
+        m_tokenizer.forEach(str, [this](const char *gram, std::size_t len) {
+            add(gram, len);
+        });
+    }
+
+    /**
+     * Add every q-gram of a string with its own number of hash functions, so that some strings weigh more in
+     * the filter than others
+     */
+    void insert(std::string_view str, uint8_t numHashes) {
+        m_tokenizer.forEach(str, [this, numHashes](const char *gram, std::size_t len) {
+            auto hashValues = hash(gram, len);
+            addHash(hashValues[0], hashValues[1], numHashes);
+        });
     }
 
     void add(const char *data, std::size_t len) {
         auto hashValues = hash(data, len);
+        addHash(hashValues[0], hashValues[1]);
+    }
 
-        for (int n = 0; n < m_numHashes; n++) {
-            uint64_t pos = nthHash(n, hashValues[0], hashValues[1], m_bits.size());
-//            std::cout << pos << std::endl;
-            m_bits[pos] = true;
+    /**
+     * Set the m_numHashes positions derived from one 128-bit hash by double hashing
+     */
+    inline void addHash(uint64_t hashA, uint64_t hashB) {
+        addHash(hashA, hashB, m_numHashes);
+    }
+
+    inline void addHash(uint64_t hashA, uint64_t hashB, uint8_t numHashes) {
+        for (int n = 0; n < numHashes; n++) {
+            set(nthHash(n, hashA, hashB, m_size));
         }
     }
 
@@ -52,15 +84,72 @@ public:
     }
 
     inline uint64_t nthHash(uint8_t n, uint64_t hashA, uint64_t hashB, uint64_t filterSize) {
-        return (hashA + n * hashB) % filterSize;
+        return reduceRange(hashA + n * hashB, filterSize);
     }
 
-    uint8_t m_numHashes;
-    std::bitset<256> m_bits;
+    inline void set(uint64_t pos) {
+        m_words[pos >> 6] |= uint64_t(1) << (pos & 63);
+    }
+
+    inline bool test(uint64_t pos) const {
+        return (m_words[pos >> 6] >> (pos & 63)) & 1;
+    }
+
+    /**
+     * OR another filter of the same length into this one
+     */
+    void merge(const BloomFilter &other) {
+        for (std::size_t i = 0; i < m_words.size(); i++) {
+            m_words[i] |= other.m_words[i];
+        }
+    }
+
+    /**
+     * Number of bits set in both this and another filter of the same length
+     */
+    inline uint64_t intersectCount(const BloomFilter &other) const {
+        return popcountAnd(m_words.data(), other.m_words.data(), m_words.size());
+    }
+
+    inline uint64_t popcount() const {
+        return popcountWords(m_words.data(), m_words.size());
+    }
+
+    /**
+     * Bits as a string of '0'/'1' characters, highest position first (same order as std::bitset::to_string)
+     */
+    std::string toString() const {
+        std::string str(m_size, '0');
+        for (uint64_t pos = 0; pos < m_size; pos++) {
+            if (test(pos)) {
+                str[m_size - 1 - pos] = '1';
+            }
+        }
+        return str;
+    }
+
+    inline const uint64_t *words() const {
+        return m_words.data();
+    }
+
+    inline std::size_t numWords() const {
+        return m_words.size();
+    }
+
+    inline uint64_t size() const {
+        return m_size;
+    }
 
     inline void reset() {
-        m_bits.reset();
+        std::fill(m_words.begin(), m_words.end(), 0);
     }
+
+    uint8_t m_numHashes;
+
+private:
+    uint64_t m_size;
+    std::vector<uint64_t> m_words;
+    QGramTokenizer m_tokenizer;
 };
 
-#endif ENTITYRESOLUTION_BH_H
\ No newline at end of file
+#endif //ENTITYRESOLUTION_BH_H
\ No newline at end of file
@@ -0,0 +1,25 @@
+#include <iostream>
+#include "FilterStore.h"
+
+using namespace std;
+
+/**
+ * Convert CSV filter files from earlier runs (attrfilters.txt, structfilters.txt) to the binary filter format
+ * Usage: convertFilters <input.txt> <output.bin> [<input.txt> <output.bin> ...]
+ */
+int main(int argc, char **argv) {
+    if (argc < 3 || argc % 2 == 0) {
+        cout << "usage: " << argv[0] << " <input.txt> <output.bin> [<input.txt> <output.bin> ...]" << endl;
+        return 1;
+    }
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        long count = convertCsvFilters(argv[i], argv[i + 1]);
+        if (count < 0) {
+            cout << "could not convert " << argv[i] << endl;
+            return 1;
+        }
+        cout << argv[i] << " -> " << argv[i + 1] << ": " << count << " filters" << endl;
+    }
+    return 0;
+}
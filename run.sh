@@ -1,5 +1,5 @@
 #!/bin/bash
 file=$1
 echo $file
-gcc "${file}.cpp" MurmurHash3.cpp -o $file -O2 -larmadillo -lstdc++ -lm
-./$file
\ No newline at end of file
+gcc "${file}.cpp" MurmurHash3.cpp -o $file -std=c++17 -O2 -march=native -pthread -larmadillo -lstdc++ -lm
+./$file "${@:2}"
\ No newline at end of file